@@ -0,0 +1,38 @@
+#ifndef _HOST_COMPAT_H
+#define _HOST_COMPAT_H
+
+// 主机构建时强制包含在内核源文件之前：
+// 内核自带的 mem* 与 libc 同名，改名后不会替换掉 libc 的实现
+#define memset kmemset
+#define memcpy kmemcpy
+#define memcmp kmemcmp
+
+// mm.c 的每 CPU 页缓存：每个压测线程当作一个 CPU，线程只访问自己的缓存，
+// 全局位图用互斥锁保护（见 host_shim.c）
+#define HOST_COMPAT
+#define MM_NCPU          8
+#define mm_cpu()         host_cpu()
+#define pcp_lock()
+#define pcp_unlock()
+#define global_lock()    host_global_lock()
+#define global_unlock()  host_global_unlock()
+
+// blk.c：主机驱动在 submit 里同步完成请求，不需要关中断，等待时条件已经成立
+#define blk_lock()
+#define blk_unlock()
+#define blk_wait(wq, cond)  while(!(cond))
+#define blk_wake(wq)
+#define blk_now()           host_now_ns()
+#define blk_ms(ms)          ((ms) * 1000000UL)
+
+// pagecache.c：文件操作只在主线程进行，不需要锁
+#define pcache_lock()
+#define pcache_unlock()
+
+int host_cpu(void);
+void host_set_cpu(int cpu);
+void host_global_lock(void);
+void host_global_unlock(void);
+unsigned long host_now_ns(void);
+
+#endif
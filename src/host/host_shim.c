@@ -0,0 +1,95 @@
+// 在 Linux 上运行 mm.c 和 fat.c 所需的替身实现
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host_shim.h"
+#include "host_compat.h"
+#include "memlayout.h"
+#include "blk.h"
+
+static int blk_fd = -1;
+static unsigned long blk_requests;
+
+// 把 MEM_START 开始的 128MB 映射成普通内存，分配器返回的地址可以直接访问
+int host_mem_init(void) {
+    void *p = mmap((void *)MEM_START, TOTAL_MEM, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if(p == MAP_FAILED || p != (void *)MEM_START) {
+        perror("mmap MEM_START");
+        return -1;
+    }
+    return 0;
+}
+
+static __thread int this_cpu;
+static pthread_mutex_t mm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int host_cpu(void) {
+    return this_cpu;
+}
+
+void host_set_cpu(int cpu) {
+    this_cpu = cpu;
+}
+
+void host_global_lock(void) {
+    pthread_mutex_lock(&mm_lock);
+}
+
+void host_global_unlock(void) {
+    pthread_mutex_unlock(&mm_lock);
+}
+
+unsigned long host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+// 块层的驱动：一个（可能合并过的）请求按段做 pread/pwrite，算一次设备请求，提交时就完成
+static int host_blk_submit(struct blk_dev *d, struct blk_req *r) {
+    int status = 0;
+    if(r->op != BLK_FLUSH) {
+        off_t off = (off_t)r->start * 512;
+        for(struct blk_req *s = r->first; s; s = s->seg) {
+            ssize_t len = s->nsect * 512;
+            ssize_t n = r->op == BLK_WRITE ? pwrite(blk_fd, s->buf, len, off) : pread(blk_fd, s->buf, len, off);
+            if(n != len)
+                status = -1;
+            off += len;
+        }
+    }
+    blk_requests++;
+    blk_end(d, r, status);
+    return 0;
+}
+
+static struct blk_dev host_dev = { .name = "vda", .submit = host_blk_submit };
+
+// 打开磁盘镜像并注册为块设备 "vda"
+int host_blk_open(const char *path) {
+    struct stat st;
+    blk_fd = open(path, O_RDWR);
+    if(blk_fd < 0 || fstat(blk_fd, &st) < 0) {
+        perror(path);
+        return -1;
+    }
+    host_dev.nsectors = st.st_size / 512;
+    blk_register(&host_dev, "deadline");
+    return 0;
+}
+
+void host_blk_close(void) {
+    if(blk_fd >= 0)
+        close(blk_fd);
+    blk_fd = -1;
+}
+
+unsigned long host_blk_requests(void) {
+    return blk_requests;
+}
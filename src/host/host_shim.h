@@ -0,0 +1,10 @@
+#ifndef _HOST_SHIM_H
+#define _HOST_SHIM_H
+
+// 主机构建的环境准备
+int host_mem_init(void);
+int host_blk_open(const char *path);
+void host_blk_close(void);
+unsigned long host_blk_requests(void);
+
+#endif
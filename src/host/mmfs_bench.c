@@ -0,0 +1,384 @@
+// 在主机上以原生速度压测页分配器和 FAT 文件系统
+// 用法：mmfs_bench <FAT16 磁盘镜像> [种子] [分配操作数] [文件操作数]
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host_shim.h"
+#include "host_compat.h"
+#include "memlayout.h"
+#include "mm.h"
+#include "blk.h"
+#include "fat.h"
+
+#define PAGE_SIZE 4096
+#define TOTAL_PAGES (TOTAL_MEM / PAGE_SIZE)
+
+// 同时存活的分配数上限
+#define MAX_LIVE 512
+// 文件工作集：根目录第一个扇区只有 16 个目录项
+#define NFILES 12
+#define MAX_FILE 512
+// 顺序读写的文件大小和轮数
+#define SEQ_SIZE 65536
+#define SEQ_ROUNDS 50
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 单类操作的延迟样本
+struct samples {
+    const char *name;
+    unsigned long long *ns;
+    long n;
+    long cap;
+};
+
+static void sample_add(struct samples *s, unsigned long long ns) {
+    if(s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1024;
+        s->ns = realloc(s->ns, s->cap * sizeof(*s->ns));
+        if(!s->ns) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    s->ns[s->n++] = ns;
+}
+
+static int cmp_ull(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// 输出一行 JSON：吞吐和延迟分位数
+static void sample_report(struct samples *s) {
+    if(s->n == 0)
+        return;
+    qsort(s->ns, s->n, sizeof(*s->ns), cmp_ull);
+    unsigned long long total = 0;
+    for(long i = 0; i < s->n; i++)
+        total += s->ns[i];
+    printf("{\"bench\":\"%s\",\"ops\":%ld,\"ops_per_sec\":%.0f,"
+           "\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}\n",
+           s->name, s->n, total ? s->n * 1e9 / total : 0.0,
+           s->ns[s->n * 50 / 100], s->ns[s->n * 90 / 100], s->ns[s->n * 99 / 100],
+           s->ns[s->n - 1]);
+}
+
+// 记录每页归属，检查分配器是否把同一页交给两个调用者
+static unsigned char shadow[TOTAL_PAGES];
+
+static int shadow_mark(void *addr, unsigned n, int used) {
+    unsigned long idx = ((unsigned long)addr - MEM_START) / PAGE_SIZE;
+    for(unsigned i = 0; i < n; i++) {
+        if(shadow[idx + i] == used) {
+            fprintf(stderr, "page %lu %s twice\n", idx + i, used ? "allocated" : "freed");
+            return -1;
+        }
+        shadow[idx + i] = used;
+    }
+    return 0;
+}
+
+// 随机申请/释放 1~16 页，偏向单页
+static int run_alloc(long ops) {
+    struct { void *addr; unsigned n; } live[MAX_LIVE];
+    int nlive = 0, errors = 0;
+    struct samples alloc = { "host_alloc_pages" }, release = { "host_free_pages" };
+
+    for(long i = 0; i < ops; i++) {
+        if(nlive < MAX_LIVE && (nlive == 0 || rand() % 2)) {
+            unsigned n = rand() % 10 < 7 ? 1 : 1 + rand() % 16;
+            unsigned long long t0 = now_ns();
+            void *p = alloc_pages(n);
+            sample_add(&alloc, now_ns() - t0);
+            if(!p)
+                continue;
+            errors += shadow_mark(p, n, 1) != 0;
+            // 触碰首尾字节，确认地址可用
+            ((char *)p)[0] = 1;
+            ((char *)p)[n * PAGE_SIZE - 1] = 1;
+            live[nlive].addr = p;
+            live[nlive].n = n;
+            nlive++;
+        } else {
+            int k = rand() % nlive;
+            errors += shadow_mark(live[k].addr, live[k].n, 0) != 0;
+            unsigned long long t0 = now_ns();
+            free_pages(live[k].addr, live[k].n);
+            sample_add(&release, now_ns() - t0);
+            live[k] = live[--nlive];
+        }
+    }
+    while(nlive > 0) {
+        nlive--;
+        shadow_mark(live[nlive].addr, live[nlive].n, 0);
+        free_pages(live[nlive].addr, live[nlive].n);
+    }
+
+    sample_report(&alloc);
+    sample_report(&release);
+    free(alloc.ns);
+    free(release.ns);
+    return errors;
+}
+
+// 多线程单页申请/释放：每个线程当作一个 CPU，比较关闭和打开每 CPU 页缓存时的吞吐
+#define MT_LIVE 64
+
+struct mt_arg {
+    int cpu;
+    long ops;
+    unsigned seed;
+    int errors;
+};
+
+static void *mt_worker(void *arg) {
+    struct mt_arg *a = arg;
+    void *live[MT_LIVE];
+    int nlive = 0;
+
+    host_set_cpu(a->cpu);
+    for(long i = 0; i < a->ops; i++) {
+        if(nlive < MT_LIVE && (nlive == 0 || rand_r(&a->seed) % 2)) {
+            void *p = alloc_pages(1);
+            if(!p)
+                continue;
+            // 多个线程同时检查 shadow，用原子交换发现重复分配
+            unsigned long idx = ((unsigned long)p - MEM_START) / PAGE_SIZE;
+            if(__atomic_exchange_n(&shadow[idx], 1, __ATOMIC_RELAXED) != 0)
+                a->errors++;
+            *(volatile char *)p = 1;
+            live[nlive++] = p;
+        } else {
+            int k = rand_r(&a->seed) % nlive;
+            unsigned long idx = ((unsigned long)live[k] - MEM_START) / PAGE_SIZE;
+            if(__atomic_exchange_n(&shadow[idx], 0, __ATOMIC_RELAXED) != 1)
+                a->errors++;
+            free_pages(live[k], 1);
+            live[k] = live[--nlive];
+        }
+    }
+    while(nlive > 0) {
+        void *p = live[--nlive];
+        shadow[((unsigned long)p - MEM_START) / PAGE_SIZE] = 0;
+        free_pages(p, 1);
+    }
+    return NULL;
+}
+
+// 把每个“CPU”缓存里的页都还给全局位图，再按 pcp 设置开关
+static void pcp_reset(int enabled) {
+    for(int c = 0; c < MM_NCPU; c++) {
+        host_set_cpu(c);
+        mm_set_pcp(0);
+    }
+    host_set_cpu(0);
+    mm_set_pcp(enabled);
+}
+
+static int run_alloc_mt(long ops) {
+    static const int nthreads[] = { 1, 2, 4 };
+    int errors = 0;
+    uint64 free_before = nr_free_pages();
+
+    for(int pcp = 0; pcp <= 1; pcp++) {
+        for(unsigned t = 0; t < sizeof(nthreads) / sizeof(nthreads[0]); t++) {
+            int n = nthreads[t];
+            pthread_t tid[MM_NCPU];
+            struct mt_arg arg[MM_NCPU];
+
+            pcp_reset(pcp);
+            unsigned long long t0 = now_ns();
+            for(int c = 0; c < n; c++) {
+                arg[c] = (struct mt_arg){ c, ops / n, rand(), 0 };
+                pthread_create(&tid[c], NULL, mt_worker, &arg[c]);
+            }
+            for(int c = 0; c < n; c++) {
+                pthread_join(tid[c], NULL);
+                errors += arg[c].errors;
+            }
+            unsigned long long ns = now_ns() - t0;
+            printf("{\"bench\":\"host_alloc_mt\",\"pcp\":%d,\"threads\":%d,\"ops\":%ld,"
+                   "\"ops_per_sec\":%.0f}\n", pcp, n, ops / n * n, ns ? ops / n * n * 1e9 / ns : 0.0);
+        }
+    }
+    pcp_reset(1);
+    if(nr_free_pages() != free_before) {
+        fprintf(stderr, "free pages %lu != %lu after threaded run\n",
+                (unsigned long)nr_free_pages(), (unsigned long)free_before);
+        errors++;
+    }
+    return errors;
+}
+
+static void file_name(char *name, int i) {
+    // 8.3 格式，不含点，空格填充
+    snprintf(name, 13, "HOST%02d  DAT", i % 100);
+}
+
+// 随机写入、读取校验、查找不存在的文件
+static int run_fs(long ops) {
+    static char content[NFILES][MAX_FILE];
+    static int size[NFILES];
+    char name[13], buf[MAX_FILE];
+    int errors = 0;
+    struct samples wr = { "host_fat_write" }, rd = { "host_fat_read" }, miss = { "host_fat_lookup_miss" };
+
+    for(long i = 0; i < ops; i++) {
+        int f = rand() % NFILES;
+        file_name(name, f);
+        int op = rand() % 10;
+        if(op < 4 || size[f] == 0) {
+            int n = 1 + rand() % MAX_FILE;
+            for(int j = 0; j < n; j++)
+                buf[j] = 'a' + (i + j) % 26;
+            unsigned long long t0 = now_ns();
+            int w = fat_write_file(name, buf, n, 0);
+            sample_add(&wr, now_ns() - t0);
+            if(w != n) {
+                fprintf(stderr, "write %s: %d != %d\n", name, w, n);
+                errors++;
+                continue;
+            }
+            memcpy(content[f], buf, n);
+            size[f] = n;
+        } else if(op < 9) {
+            unsigned long long t0 = now_ns();
+            int r = fat_read_file(name, buf, size[f], 0);
+            sample_add(&rd, now_ns() - t0);
+            if(r != size[f] || memcmp(buf, content[f], size[f]) != 0) {
+                fprintf(stderr, "read %s: content mismatch\n", name);
+                errors++;
+            }
+        } else {
+            unsigned long long t0 = now_ns();
+            int r = fat_read_file("NOSUCH  DAT", buf, 1, 0);
+            sample_add(&miss, now_ns() - t0);
+            if(r != -1)
+                errors++;
+        }
+    }
+
+    sample_report(&wr);
+    sample_report(&rd);
+    sample_report(&miss);
+    free(wr.ns);
+    free(rd.ns);
+    free(miss.ns);
+    return errors;
+}
+
+// 追加写：每次 512 字节和每次 4KB 地追加，跨过多个簇边界，检查返回值、文件大小和内容
+static int run_append(void) {
+    static char buf[SEQ_SIZE], rbuf[SEQ_SIZE];
+    static const struct { const char *name; int chunk; int total; } cases[] = {
+        { "HOSTAPP DAT", 512, 20 * 512 + 100 },
+        { "HOSTAPP4DAT", 4096, 4 * 4096 },
+    };
+    int errors = 0;
+    for(int c = 0; c < 2; c++) {
+        int total = cases[c].total;
+        for(int i = 0; i < total; i++)
+            buf[i] = 'A' + (i * 13 + c) % 26;
+        for(int off = 0; off < total; off += cases[c].chunk) {
+            int n = total - off < cases[c].chunk ? total - off : cases[c].chunk;
+            int w = fat_write_file(cases[c].name, buf + off, n, off);
+            if(w != n) {
+                fprintf(stderr, "append %s at %d: %d != %d\n", cases[c].name, off, w, n);
+                errors++;
+            }
+        }
+        if(fat_file_size(cases[c].name) != total || fat_read_file(cases[c].name, rbuf, total, 0) != total ||
+           memcmp(buf, rbuf, total) != 0) {
+            fprintf(stderr, "append %s: size %d, content mismatch\n", cases[c].name, fat_file_size(cases[c].name));
+            errors++;
+        }
+    }
+    return errors;
+}
+
+// 输出一行 JSON：两次统计之间块层收到的请求、其中被合并的比例和实际发给驱动的请求数
+static void blk_report(const char *name, const char *sched, struct blk_stats *a, struct blk_stats *b) {
+    unsigned long reqs = b->reqs - a->reqs, merges = b->merges - a->merges;
+    printf("{\"bench\":\"%s\",\"sched\":\"%s\",\"reqs\":%lu,\"merges\":%lu,\"dispatched\":%lu,\"merge_pct\":%.1f}\n",
+           name, sched, reqs, merges, (unsigned long)(b->dispatched - a->dispatched),
+           reqs ? 100.0 * merges / reqs : 0.0);
+}
+
+// 用调度器 sched 反复整体写入再读回一个 64KB 文件：簇内和相邻簇的整扇区成批提交，在队列中合并。
+// 读绕过页缓存，每次都经过块层
+static int run_seq(const char *sched) {
+    static char buf[SEQ_SIZE], rbuf[SEQ_SIZE];
+    struct blk_dev *d = blk_lookup("vda");
+    struct blk_stats before, after;
+    struct samples wr = { "host_fat_seq_write_64k" }, rd = { "host_fat_seq_read_64k" };
+    int errors = 0;
+
+    if(blk_set_sched(d, sched) != 0)
+        return 1;
+    for(int i = 0; i < SEQ_SIZE; i++)
+        buf[i] = i * 7 + sched[0];
+    blk_get_stats(d, &before);
+    for(int i = 0; i < SEQ_ROUNDS; i++) {
+        unsigned long long t0 = now_ns();
+        if(fat_write_file("HOSTSEQ DAT", buf, SEQ_SIZE, 0) != SEQ_SIZE)
+            errors++;
+        sample_add(&wr, now_ns() - t0);
+        t0 = now_ns();
+        if(fat_read_direct("HOSTSEQ DAT", rbuf, SEQ_SIZE, 0) != SEQ_SIZE || memcmp(buf, rbuf, SEQ_SIZE) != 0)
+            errors++;
+        sample_add(&rd, now_ns() - t0);
+    }
+    blk_get_stats(d, &after);
+    sample_report(&wr);
+    sample_report(&rd);
+    blk_report("host_blk_merge_seq", sched, &before, &after);
+    free(wr.ns);
+    free(rd.ns);
+    if(errors)
+        fprintf(stderr, "seq %s: %d errors\n", sched, errors);
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s disk.img [seed] [alloc-ops] [fs-ops]\n", argv[0]);
+        return 2;
+    }
+    unsigned seed = argc > 2 ? strtoul(argv[2], 0, 0) : 1;
+    long alloc_ops = argc > 3 ? strtol(argv[3], 0, 0) : 1000000;
+    long fs_ops = argc > 4 ? strtol(argv[4], 0, 0) : 20000;
+    srand(seed);
+
+    if(host_mem_init() != 0 || host_blk_open(argv[1]) != 0)
+        return 1;
+    init_mm();
+    if(fat_init() != 0) {
+        fprintf(stderr, "fat_init failed\n");
+        return 1;
+    }
+
+    int errors = run_alloc(alloc_ops);
+    errors += run_alloc_mt(alloc_ops * 10);
+    struct blk_stats before, after;
+    blk_get_stats(blk_lookup("vda"), &before);
+    errors += run_fs(fs_ops);
+    blk_get_stats(blk_lookup("vda"), &after);
+    blk_report("host_blk_merge_mixed", "deadline", &before, &after);
+    errors += run_append();
+    errors += run_seq("noop");
+    errors += run_seq("deadline");
+    printf("{\"bench\":\"host_summary\",\"seed\":%u,\"blk_requests\":%lu,\"errors\":%d}\n",
+           seed, host_blk_requests(), errors);
+    host_blk_close();
+    if(!errors)
+        fprintf(stderr, "done; validate the image with: fsck.fat -n %s\n", argv[1]);
+    return errors ? 1 : 0;
+}
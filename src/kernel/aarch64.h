@@ -11,4 +11,96 @@ static inline uint64 cpuid()
   return x & 0xff;
 }
 
+// DAIF 中断屏蔽位
+#define DAIF_I (1 << 7)  // IRQ 屏蔽
+
+static inline uint64 r_daif()
+{
+  uint64 x;
+  asm volatile("mrs %0, daif" : "=r" (x) );
+  return x;
+}
+
+// 打开 IRQ
+static inline void intr_on()
+{
+  asm volatile("msr daifclr, #2" ::: "memory");
+}
+
+// 关闭 IRQ
+static inline void intr_off()
+{
+  asm volatile("msr daifset, #2" ::: "memory");
+}
+
+// IRQ 是否打开
+static inline int intr_get()
+{
+  return (r_daif() & DAIF_I) == 0;
+}
+
+// 异常向量表基址
+static inline void w_vbar_el1(uint64 x)
+{
+  asm volatile("msr vbar_el1, %0; isb" : : "r" (x) );
+}
+
+// 异常综合信息
+static inline uint64 r_esr_el1()
+{
+  uint64 x;
+  asm volatile("mrs %0, esr_el1" : "=r" (x) );
+  return x;
+}
+
+// 异常返回地址
+static inline uint64 r_elr_el1()
+{
+  uint64 x;
+  asm volatile("mrs %0, elr_el1" : "=r" (x) );
+  return x;
+}
+
+// 出错虚拟地址
+static inline uint64 r_far_el1()
+{
+  uint64 x;
+  asm volatile("mrs %0, far_el1" : "=r" (x) );
+  return x;
+}
+
+// 通用定时器频率（Hz）
+static inline uint64 r_cntfrq()
+{
+  uint64 x;
+  asm volatile("mrs %0, cntfrq_el0" : "=r" (x) );
+  return x;
+}
+
+// 通用定时器物理计数
+static inline uint64 r_cntpct()
+{
+  uint64 x;
+  asm volatile("isb; mrs %0, cntpct_el0" : "=r" (x) : : "memory");
+  return x;
+}
+
+// 通用定时器虚拟计数
+static inline uint64 r_cntvct()
+{
+  uint64 x;
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r" (x) : : "memory");
+  return x;
+}
+
+// DC ZVA 块大小：低 4 位为 log2(字数)，DZP 置位时禁止使用
+#define DCZID_DZP (1 << 4)
+
+static inline uint64 r_dczid()
+{
+  uint64 x;
+  asm volatile("mrs %0, dczid_el0" : "=r" (x) );
+  return x;
+}
+
 #endif
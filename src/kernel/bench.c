@@ -0,0 +1,858 @@
+#include "bench.h"
+#include "aarch64.h"
+#include "blk.h"
+#include "fat.h"
+#include "ipc.h"
+#include "memlayout.h"
+#include "mm.h"
+#include "neon.h"
+#include "pagecache.h"
+#include "printk.h"
+#include "proc.h"
+#include "psci.h"
+#include "ramdisk.h"
+#include "timer.h"
+#include "trap.h"
+#include "virtio_blk.h"
+#include "vm.h"
+
+// 基准测试程序：每项结果输出一行 JSON，全部完成后通过 PSCI 关机
+// 由 bench.elf 构建（CONFIG_BENCH），make bench 负责运行并保存结果
+// 启动阶段耗时由 kinit 打印在结果之前
+
+struct bench {
+    const char *name;
+    void (*fn)(void);
+};
+
+// 块设备测试使用磁盘末尾的扇区，避开 FAT 元数据和前部的数据簇
+#define BENCH_SECTOR 20000
+#define BENCH_SECTORS 256
+
+uint64 ticks_to_ns(uint64 ticks) {
+    return ticks * 1000000000 / r_cntfrq();
+}
+
+// 输出一行结果；bytes 非 0 时附带带宽
+void bench_report(const char *name, uint64 iters, uint64 ticks, uint64 bytes) {
+    uint64 ns = ticks_to_ns(ticks);
+    if(ns == 0)
+        ns = 1;
+    char line[256];
+    int n = snprintf(line, sizeof(line),
+                     "{\"bench\":\"%s\",\"iters\":%lu,\"ns\":%lu,\"ns_per_op\":%lu,\"ops_per_sec\":%lu",
+                     name, iters, ns, ns / iters, iters * 1000000000 / ns);
+    if(bytes)
+        n += snprintf(line + n, sizeof(line) - n, ",\"mb_per_sec\":%lu",
+                      bytes * 1000000000 / ns / (1024 * 1024));
+    pr_info("%s}\n", line);
+    log_flush();
+}
+
+// 单页申请后立即释放
+// page_alloc_free_1_nopcp 关闭每 CPU 页缓存，单页也直接扫描全局位图
+static void bench_page_alloc_1(void) {
+    const int iters = 10000;
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < iters; i++)
+        free_pages(alloc_pages(1), 1);
+    bench_report("page_alloc_free_1", iters, r_cntvct() - t0, 0);
+
+    mm_set_pcp(0);
+    t0 = r_cntvct();
+    for(int i = 0; i < iters; i++)
+        free_pages(alloc_pages(1), 1);
+    bench_report("page_alloc_free_1_nopcp", iters, r_cntvct() - t0, 0);
+    mm_set_pcp(1);
+}
+
+// 16 页连续申请后立即释放
+static void bench_page_alloc_16(void) {
+    const int iters = 2000;
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < iters; i++)
+        free_pages(alloc_pages(16), 16);
+    bench_report("page_alloc_free_16", iters, r_cntvct() - t0, 0);
+}
+
+// 连续申请一批单页再全部释放，位图越满扫描越慢
+static void bench_page_alloc_batch(void) {
+    enum { N = 1024 };
+    static void *pages[N];
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < N; i++)
+        pages[i] = alloc_pages(1);
+    uint64 t1 = r_cntvct();
+    for(int i = 0; i < N; i++)
+        free_pages(pages[i], 1);
+    uint64 t2 = r_cntvct();
+    bench_report("page_alloc_batch", N, t1 - t0, 0);
+    bench_report("page_free_batch", N, t2 - t1, 0);
+
+    mm_set_pcp(0);
+    t0 = r_cntvct();
+    for(int i = 0; i < N; i++)
+        pages[i] = alloc_pages(1);
+    t1 = r_cntvct();
+    for(int i = 0; i < N; i++)
+        free_pages(pages[i], 1);
+    t2 = r_cntvct();
+    mm_set_pcp(1);
+    bench_report("page_alloc_batch_nopcp", N, t1 - t0, 0);
+    bench_report("page_free_batch_nopcp", N, t2 - t1, 0);
+}
+
+// 申请一页清零的页：零页池命中、池空时在申请路径上用 DC ZVA 清零、申请后 memset 三种方式对比
+static void bench_page_alloc_zero(void) {
+    enum { N = 32 };
+    static void *pages[N], *hold[N * 2];
+    struct zero_stats st;
+    while(mm_zero_fill())
+        ;
+
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < N; i++)
+        pages[i] = alloc_pages_flags(1, ALLOC_ZERO);
+    bench_report("page_alloc_zero_pool", N, r_cntvct() - t0, 0);
+    for(int i = 0; i < N; i++)
+        free_pages(pages[i], 1);
+
+    // 取空零页池
+    mm_zero_get_stats(&st);
+    int nhold = 0;
+    while(nhold < N * 2 && st.pooled-- > 0)
+        hold[nhold++] = alloc_pages_flags(1, ALLOC_ZERO);
+    t0 = r_cntvct();
+    for(int i = 0; i < N; i++)
+        pages[i] = alloc_pages_flags(1, ALLOC_ZERO);
+    bench_report("page_alloc_zero_dczva", N, r_cntvct() - t0, 0);
+    for(int i = 0; i < N; i++)
+        free_pages(pages[i], 1);
+
+    t0 = r_cntvct();
+    for(int i = 0; i < N; i++) {
+        pages[i] = alloc_pages(1);
+        memset(pages[i], 0, PAGE_SIZE);
+    }
+    bench_report("page_alloc_memset", N, r_cntvct() - t0, 0);
+    for(int i = 0; i < N; i++)
+        free_pages(pages[i], 1);
+    for(int i = 0; i < nhold; i++)
+        free_pages(hold[i], 1);
+
+    mm_zero_get_stats(&st);
+    pr_info("{\"bench_mem\":\"zero_pool\",\"filled\":%lu,\"hits\":%lu,\"misses\":%lu}\n",
+            st.filled, st.hits, st.misses);
+}
+
+static volatile int pingpong_done;
+
+static void pingpong_partner(void) {
+    while(!pingpong_done)
+        yield();
+}
+
+// 两个进程互相 yield，一次往返包含两次进程间的直接切换
+static void bench_ctx_switch(void) {
+    const int iters = 10000;
+    struct proc *p = kthread_create(pingpong_partner);
+    if(!p) {
+        pr_err("bench: kthread_create failed\n");
+        return;
+    }
+    pingpong_done = 0;
+    proc_ready(p);
+    yield();
+
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < iters; i++)
+        yield();
+    uint64 t1 = r_cntvct();
+
+    pingpong_done = 1;
+    yield();
+    bench_report("ctx_switch_roundtrip", iters, t1 - t0, 0);
+    // 同一组数据按单次切换计，ns_per_op 即每次切换的纳秒数
+    bench_report("yield_switch", 2 * iters, t1 - t0, 0);
+}
+
+static void fp_pingpong_partner(void) {
+    while(!pingpong_done) {
+        fpsimd_fill(2);
+        yield();
+    }
+}
+
+// 两个进程都在使用 FP/SIMD，每次切换都要陷入并保存/恢复一次寄存器
+static void bench_ctx_switch_fpsimd(void) {
+    const int iters = 10000;
+    struct proc *p = kthread_create(fp_pingpong_partner);
+    if(!p) {
+        pr_err("bench: kthread_create failed\n");
+        return;
+    }
+    pingpong_done = 0;
+    proc_ready(p);
+    yield();
+
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < iters; i++) {
+        fpsimd_fill(1);
+        yield();
+    }
+    uint64 t1 = r_cntvct();
+
+    pingpong_done = 1;
+    yield();
+    bench_report("ctx_switch_roundtrip_fpsimd", iters, t1 - t0, 0);
+}
+
+// 两个用户进程互相 yield，分别在使用 ASID 和每次切换都刷新 TLB 时测量
+static void bench_user_switch(void) {
+    const int iters = 5000;
+    for(int asid = 1; asid >= 0; asid--) {
+        vm_set_asid(asid);
+        struct proc *a = user_create("yielder", iters);
+        struct proc *b = user_create("yielder", iters);
+        if(!a || !b) {
+            pr_err("bench: user_create failed\n");
+            return;
+        }
+        uint64 pa = a->pid, pb = b->pid;
+        uint64 t0 = r_cntvct();
+        proc_ready(a);
+        proc_ready(b);
+        proc_wait(pa);
+        proc_wait(pb);
+        uint64 t1 = r_cntvct();
+        bench_report(asid ? "user_switch_asid" : "user_switch_tlb_flush", 2 * iters, t1 - t0, 0);
+    }
+    vm_set_asid(1);
+}
+
+// 运行一个用掉 kib KB 栈的用户进程并等它退出，返回耗时
+static uint64 run_stack_proc(uint64 kib) {
+    uint64 t0 = r_cntvct();
+    struct proc *p = user_create("stack", kib);
+    if(!p)
+        return 0;
+    uint64 pid = p->pid;
+    proc_ready(p);
+    proc_wait(pid);
+    return r_cntvct() - t0;
+}
+
+// 用户栈按需分配：空闲进程实际占用的内存，以及每次栈缺页的开销
+static void bench_user_stack(void) {
+    enum { N = 8 };
+    struct proc *ps[N];
+    uint64 pids[N];
+    int n = 0;
+    // 进程用完栈后在通道上睡眠，关闭通道才退出，测量时它们一定都还活着
+    int id = chan_create();
+    if(id < 0) {
+        pr_err("bench: chan_create failed\n");
+        return;
+    }
+    uint64 free0 = nr_free_pages();
+    for(; n < N; n++) {
+        ps[n] = user_create("stack", 4 | 1UL << 32 | (uint64)id << 40);
+        if(!ps[n]) {
+            pr_err("bench: user_create failed\n");
+            break;
+        }
+        pids[n] = ps[n]->pid;
+        proc_ready(ps[n]);
+    }
+    // 等每个进程都睡在通道上；意外退出的进程查不到，不再计入
+    int alive = 0;
+    for(int i = 0; i < n; i++) {
+        struct proc *p;
+        while((p = proc_lookup(pids[i])) && p->state != BLOCKED)
+            yield();
+        alive += p != 0;
+    }
+    if(n == N && alive == N) {
+        uint64 used = free0 - nr_free_pages();
+        uint64 stack = 0;
+        for(int i = 0; i < N; i++)
+            stack += USER_STACK_TOP - ps[i]->stack_low;
+        pr_info("{\"bench_mem\":\"user_stack\",\"procs\":%d,\"kb_per_proc\":%lu,"
+                "\"stack_kb_per_proc\":%lu,\"stack_reserved_kb\":%lu}\n",
+                N, used * PAGE_SIZE / 1024 / N, stack / 1024 / N, USER_STACK_SIZE / 1024);
+    } else if(n == N) {
+        pr_err("bench: user_stack process exited early\n");
+    }
+    chan_close(id);
+    for(int i = 0; i < n; i++)
+        proc_wait(pids[i]);
+    if(alive < N)
+        return;
+
+    // 256KB 栈比不用栈多出 64 次缺页
+    uint64 base = run_stack_proc(0);
+    uint64 deep = run_stack_proc(256);
+    bench_report("user_stack_fault", 256 / 4, deep > base ? deep - base : 1, 0);
+}
+
+// fork + exit：父进程反复 fork，子进程立即退出，父进程等待。
+// 先用掉 256KB 栈再 fork，对比开销是否随已用内存增长
+static void bench_fork(void) {
+    const uint64 iters = 500;
+    const uint64 kib[] = { 0, 256 };
+    for(int i = 0; i < 2; i++) {
+        uint64 t0 = r_cntvct();
+        struct proc *p = user_create("forker", kib[i] << 32 | iters);
+        if(!p) {
+            pr_err("bench: user_create failed\n");
+            return;
+        }
+        uint64 pid = p->pid;
+        proc_ready(p);
+        proc_wait(pid);
+        bench_report(kib[i] ? "fork_exit_256k" : "fork_exit", iters, r_cntvct() - t0, 0);
+    }
+}
+
+// 按伪随机顺序读遍全部 RAM 的页，每页一次，TLB 容纳不下 4KB 页的映射。
+// 先把内核线性映射换成全 4KB 页，再换回块映射，对比页表遍历的开销
+static void bench_kernel_map(void) {
+    const uint64 npages = TOTAL_MEM / PAGE_SIZE;
+    const uint64 iters = 200000;
+    for(int large = 0; large < 2; large++) {
+        kernel_remap(large);
+        uint64 x = 1, sum = 0;
+        uint64 t0 = r_cntvct();
+        for(uint64 i = 0; i < iters; i++) {
+            x = x * 1103515245 + 12345;
+            uint64 pa = MEM_START + ((x >> 16) % npages) * PAGE_SIZE;
+            sum += *(volatile uint64 *)P2V(pa);
+        }
+        uint64 t1 = r_cntvct();
+        bench_report(large ? "tlb_walk_block" : "tlb_walk_4k", iters, t1 - t0, 0);
+        (void)sum;
+    }
+}
+
+// 创建 16KB 的映射测试文件，第 i 个字节是 i & 0xff
+static int make_maptest(void) {
+    uint8 *buf = alloc_pages(4);
+    if(!buf)
+        return -1;
+    for(int i = 0; i < 16384; i++)
+        buf[i] = i;
+    int r = fat_write_file("MAPTEST BIN", buf, 16384, 0);
+    free_pages(buf, 4);
+    return r == 16384 ? 0 : -1;
+}
+
+static void run_mapper(uint64 arg) {
+    struct proc *p = user_create("mapper", arg);
+    if(!p) {
+        pr_err("bench: user_create failed\n");
+        return;
+    }
+    uint64 pid = p->pid;
+    proc_ready(p);
+    proc_wait(pid);
+}
+
+// 反复读同一个 16KB 文件：fat_read_file 从页缓存拷贝，没有设备请求；
+// mmap 预热之后直接访问页缓存，连拷贝也没有
+static void bench_mmap(void) {
+    const uint64 iters = 200;
+    if(make_maptest() < 0) {
+        pr_err("bench: make_maptest failed\n");
+        return;
+    }
+    uint8 *buf = alloc_pages(4);
+    if(!buf)
+        return;
+    uint64 t0 = r_cntvct();
+    for(uint64 i = 0; i < iters; i++)
+        fat_read_file("MAPTEST BIN", buf, 16384, 0);
+    bench_report("file_read_16k", iters, r_cntvct() - t0, iters * 16384);
+    free_pages(buf, 4);
+
+    run_mapper(1);
+    struct pcache_stats st0, st1;
+    pcache_get_stats(&st0);
+    t0 = r_cntvct();
+    run_mapper(iters);
+    bench_report("mmap_read_16k", iters, r_cntvct() - t0, iters * 16384);
+    pcache_get_stats(&st1);
+    pr_info("{\"bench_pcache\":\"mmap_read_16k\",\"hits\":%lu,\"misses\":%lu}\n",
+            st1.hits - st0.hits, st1.misses - st0.misses);
+}
+
+static struct wait_queue idle_wq = WAIT_QUEUE_INIT;
+static int idle_done;
+
+static void idle_wake(struct timer *t) {
+    idle_done = 1;
+    wake_all(&idle_wq);
+}
+
+// 空闲 1 秒：唯一的工作是一个定时事件，CPU 应几乎全程停在 WFI 里。
+// 同时报告定时事件到期到进程恢复运行的延迟
+static void bench_idle(void) {
+    struct cpu *c = mycpu();
+    struct timer t;
+    uint64 idle0 = c->idle_ticks;
+    uint64 t0 = r_cntvct();
+    uint64 deadline = t0 + r_cntfrq();
+    idle_done = 0;
+    timer_add(&t, deadline, idle_wake);
+    wait_event(&idle_wq, idle_done);
+    uint64 t1 = r_cntvct();
+    pr_info("{\"bench_idle\":\"idle_1s\",\"idle_pct\":%lu}\n",
+            (c->idle_ticks - idle0) * 100 / (t1 - t0));
+    bench_report("timer_wakeup", 1, t1 - deadline, 0);
+}
+
+static void timer_nop(struct timer *t) {
+}
+
+// 定时事件的加入和取消：先放入 0 个和 10000 个 1 秒后才陆续到期的事件，再测一对 timer_add/timer_cancel
+// 的耗时，时间轮上两者应当基本相同。随后报告 sleep_ns(100us) 实际睡眠时间超出的部分
+static void bench_timer(void) {
+    const uint64 n = 10000, iters = 100000, sleeps = 200;
+    const uint64 npages = PGROUNDUP(n * sizeof(struct timer)) / PAGE_SIZE;
+    struct timer *bg = alloc_pages(npages);
+    if(!bg)
+        return;
+    for(int k = 0; k < 2; k++) {
+        uint64 nbg = k ? n : 0;
+        uint64 now = r_cntvct();
+        for(uint64 i = 0; i < nbg; i++)
+            timer_add(&bg[i], now + r_cntfrq() + i * 997, timer_nop);
+        struct timer t;
+        uint64 t0 = r_cntvct();
+        for(uint64 i = 0; i < iters; i++) {
+            timer_add(&t, t0 + r_cntfrq() / 2 + i * 13, timer_nop);
+            timer_cancel(&t);
+        }
+        bench_report(k ? "timer_add_cancel_10000" : "timer_add_cancel_0", iters, r_cntvct() - t0, 0);
+        for(uint64 i = 0; i < nbg; i++)
+            timer_cancel(&bg[i]);
+    }
+    free_pages(bg, npages);
+
+    uint64 over = 0, want = ns_to_ticks(100000);
+    for(uint64 i = 0; i < sleeps; i++) {
+        uint64 t0 = r_cntvct();
+        sleep_ns(100000);
+        over += r_cntvct() - t0 - want;
+    }
+    bench_report("sleep_100us_overshoot", sleeps, over, 0);
+}
+
+// 公平调度：nice 0 和 nice 5 的两个 CPU 密集进程（权重 1024 和 335）同时运行，
+// 前者结束时后者应得到约 335 / (1024 + 335) ≈ 25% 的 CPU。
+// 随后只剩后者在运行，测量定时事件唤醒本进程的延迟
+static void bench_fair(void) {
+    const uint64 spins = 100000000;
+    struct proc *a = user_create("spin", spins);
+    struct proc *b = user_create("spin", spins);
+    if(!a || !b) {
+        pr_err("bench: user_create failed\n");
+        return;
+    }
+    proc_set_nice(b, 5);
+    uint64 pa = a->pid, pb = b->pid;
+    uint64 t0 = r_cntvct();
+    proc_ready(a);
+    proc_ready(b);
+    proc_wait(pa);
+    uint64 wall = ticks_to_ns(r_cntvct() - t0);
+    pr_info("{\"bench_sched\":\"fair_nice5\",\"share_permille\":%lu,\"expect_permille\":%lu}\n",
+            proc_cputime(pb) * 1000 / wall, 335UL * 1000 / (1024 + 335));
+
+    struct timer t;
+    uint64 deadline = r_cntvct() + r_cntfrq() / 100;
+    idle_done = 0;
+    timer_add(&t, deadline, idle_wake);
+    wait_event(&idle_wq, idle_done);
+    bench_report("timer_wakeup_busy", 1, r_cntvct() - deadline, 0);
+    proc_wait(pb);
+}
+
+// IPC：两个 ipcpeer 进程经共享消息环传递 64 字节内联消息，以及每条 64KB 的整页转移。
+// 计时包含两个进程的创建和退出
+static void bench_ipc(void) {
+    static const struct { const char *name; uint64 mode, n, size; } runs[] = {
+        { "ipc_msg_64", 0, 20000, 64 },
+        { "ipc_pages_64k", 1UL << 9, 2000, 64 * 1024 },
+    };
+    for(uint32 r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+        int id = chan_create();
+        uint64 arg = (uint64)id | runs[r].mode | runs[r].n << 32;
+        struct proc *rx = id < 0 ? 0 : user_create("ipcpeer", arg | 1UL << 8);
+        struct proc *tx = rx ? user_create("ipcpeer", arg) : 0;
+        if(!tx) {
+            pr_err("bench: ipc setup failed\n");
+            return;
+        }
+        uint64 prx = rx->pid, ptx = tx->pid;
+        uint64 t0 = r_cntvct();
+        proc_ready(rx);
+        proc_ready(tx);
+        proc_wait(prx);
+        proc_wait(ptx);
+        bench_report(runs[r].name, runs[r].n, r_cntvct() - t0, runs[r].n * runs[r].size);
+        chan_close(id);
+    }
+}
+
+// 同步调用往返：pingpong 客户与服务进程经端点调用和回复，快速路径上每次往返
+// 是两次系统调用和两次直接切换。同时用 PMU 周期计数器算出每次往返的周期数
+static void bench_call(void) {
+    const uint64 n = 100000;
+    int ep = ep_create();
+    struct proc *server = ep < 0 ? 0 : user_create("pingpong", (uint64)ep | 1UL << 8);
+    struct proc *client = server ? user_create("pingpong", (uint64)ep | n << 32) : 0;
+    if(!client) {
+        pr_err("bench: call setup failed\n");
+        return;
+    }
+    uint64 ps = server->pid, pc = client->pid;
+    // 服务进程先进入 reply_wait，客户的调用全部走快速路径
+    proc_ready(server);
+    yield();
+    struct pmu_counts c0;
+    c0 = mycpu()->pmu;
+    uint64 t0 = r_cntvct();
+    proc_ready(client);
+    proc_wait(pc);
+    uint64 t1 = r_cntvct();
+    proc_wait(ps);
+    uint64 cycles = mycpu()->pmu.cycles - c0.cycles;
+    bench_report("call_reply", n, t1 - t0, 0);
+    pr_info("{\"bench_ipc\":\"call_reply\",\"cycles_per_roundtrip\":%lu}\n", cycles / n);
+}
+
+// 创建 64KB 的 I/O 环测试文件，第 i 个字节是 (i >> 9) + i 的低 8 位，与 iobench 的检查一致
+static int make_iobench(void) {
+    uint8 *buf = alloc_pages(16);
+    if(!buf)
+        return -1;
+    for(int i = 0; i < 65536; i++)
+        buf[i] = (i >> 9) + i;
+    int r = fat_write_file("IOBENCH BIN", buf, 65536, 0);
+    free_pages(buf, 16);
+    return r == 65536 ? 0 : -1;
+}
+
+// 4KB 读：阻塞的 fat_read_direct（绕过页缓存）每次查目录、沿簇链逐个扇区等设备完成；
+// iobench 经异步 I/O 环提交，队列深度 1 和 16，扇区请求同时交给设备，完成时在中断里写 CQE
+static void bench_ioring(void) {
+    const uint64 n = 2000;
+    static const struct { const char *name; uint64 depth; } runs[] = {
+        { "ioring_read_4k_qd1", 1 },
+        { "ioring_read_4k_qd16", 16 },
+    };
+    uint8 *buf = make_iobench() < 0 ? 0 : alloc_pages(1);
+    if(!buf) {
+        pr_err("bench: make_iobench failed\n");
+        return;
+    }
+    uint64 t0 = r_cntvct();
+    for(uint64 i = 0; i < n; i++)
+        fat_read_direct("IOBENCH BIN", buf, 4096, i * 4096 % 65536);
+    bench_report("fat_read_4k", n, r_cntvct() - t0, n * 4096);
+    free_pages(buf, 1);
+    for(uint32 r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+        struct proc *p = user_create("iobench", n | runs[r].depth << 32);
+        if(!p) {
+            pr_err("bench: user_create failed\n");
+            return;
+        }
+        uint64 pid = p->pid;
+        t0 = r_cntvct();
+        proc_ready(p);
+        proc_wait(pid);
+        bench_report(runs[r].name, n, r_cntvct() - t0, n * 4096);
+    }
+}
+
+// 进程控制块和 PID：分别在 100 和 20000 个存活进程时测量分配、按 PID 查找、释放的单次耗时，
+// 两组结果应当基本相同。只测控制块和 PID 本身，不分配内核栈
+static void bench_pid(void) {
+    static const uint64 counts[] = { 100, 20000 };
+    static const char *names[][3] = {
+        { "proc_alloc_100", "pid_lookup_100", "proc_free_100" },
+        { "proc_alloc_20000", "pid_lookup_20000", "proc_free_20000" },
+    };
+    const uint64 npages = PGROUNDUP(20000 * sizeof(struct proc *)) / PAGE_SIZE;
+    struct proc **ps = alloc_pages(npages);
+    if(!ps)
+        return;
+    for(int k = 0; k < 2; k++) {
+        uint64 n = counts[k];
+        uint64 t0 = r_cntvct();
+        for(uint64 i = 0; i < n; i++) {
+            if((ps[i] = proc_alloc()) == 0) {
+                pr_err("bench: proc_alloc failed at %lu\n", i);
+                n = i;
+                break;
+            }
+        }
+        uint64 t1 = r_cntvct();
+        uint64 missing = 0;
+        for(uint64 i = 0; i < n; i++)
+            if(proc_lookup(ps[i * 7919 % n]->pid) == 0)
+                missing++;
+        uint64 t2 = r_cntvct();
+        for(uint64 i = 0; i < n; i++)
+            proc_free(ps[i]);
+        uint64 t3 = r_cntvct();
+        if(missing)
+            pr_err("bench: %lu pids not found\n", missing);
+        bench_report(names[k][0], n, t1 - t0, 0);
+        bench_report(names[k][1], n, t2 - t1, 0);
+        bench_report(names[k][2], n, t3 - t2, 0);
+    }
+    free_pages(ps, npages);
+}
+
+static uint32 scalar_checksum(const void *buf, uint64 len) {
+    const uint8 *p = buf;
+    uint32 sum = 0;
+    while(len--)
+        sum += *p++;
+    return sum;
+}
+
+// 64KB 字节校验和：标量与 NEON 对比
+static void bench_checksum(void) {
+    const int iters = 64;
+    const uint32 size = 64 * 1024;
+    uint8 *buf = alloc_pages(16);
+    for(uint32 i = 0; i < size; i++)
+        buf[i] = i * 7;
+    volatile uint32 sink;
+
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < iters; i++)
+        sink = scalar_checksum(buf, size);
+    uint64 t1 = r_cntvct();
+    for(int i = 0; i < iters; i++)
+        sink = neon_checksum(buf, size);
+    uint64 t2 = r_cntvct();
+
+    if(neon_checksum(buf, size) != scalar_checksum(buf, size))
+        pr_err("bench: neon_checksum mismatch\n");
+    (void)sink;
+    bench_report("checksum_scalar_64k", iters, t1 - t0, (uint64)iters * size);
+    bench_report("checksum_neon_64k", iters, t2 - t1, (uint64)iters * size);
+    free_pages(buf, 16);
+}
+
+// 64KB 块拷贝带宽
+static void bench_memcpy(void) {
+    const int iters = 256;
+    const uint32 size = 64 * 1024;
+    void *src = alloc_pages(16);
+    void *dst = alloc_pages(16);
+    memset(src, 0x5a, size);
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < iters; i++)
+        memcpy(dst, src, size);
+    bench_report("memcpy_64k", iters, r_cntvct() - t0, (uint64)iters * size);
+    free_pages(src, 16);
+    free_pages(dst, 16);
+}
+
+// 同一扇区反复读取，衡量单请求延迟
+static void bench_virtio_iops(void) {
+    const int iters = 1000;
+    char buf[512];
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < iters; i++)
+        virtio_blk_rw(buf, BENCH_SECTOR, 0);
+    bench_report("virtio_read_iops", iters, r_cntvct() - t0, (uint64)iters * 512);
+}
+
+// 顺序写入、读回一段扇区
+static void bench_virtio_seq(void) {
+    char buf[512];
+    memset(buf, 0xa5, sizeof(buf));
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < BENCH_SECTORS; i++)
+        virtio_blk_rw(buf, BENCH_SECTOR + i, 1);
+    uint64 t1 = r_cntvct();
+    for(int i = 0; i < BENCH_SECTORS; i++)
+        virtio_blk_rw(buf, BENCH_SECTOR + i, 0);
+    uint64 t2 = r_cntvct();
+    bench_report("virtio_seq_write", BENCH_SECTORS, t1 - t0, BENCH_SECTORS * 512);
+    bench_report("virtio_seq_read", BENCH_SECTORS, t2 - t1, BENCH_SECTORS * 512);
+}
+
+// FAT 文件创建、覆盖写、读取和目录查找
+static void bench_fat(void) {
+    enum { NFILES = 8, ITERS = 200 };
+    char name[12] = "BENCH0  TXT";
+    char buf[512];
+    memset(buf, 'b', sizeof(buf));
+
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < NFILES; i++) {
+        name[5] = '0' + i;
+        if(fat_write_file(name, buf, sizeof(buf), 0) != sizeof(buf))
+            pr_err("bench: fat create %s failed\n", name);
+    }
+    uint64 t1 = r_cntvct();
+    bench_report("fat_create", NFILES, t1 - t0, 0);
+
+    name[5] = '0';
+    t0 = r_cntvct();
+    for(int i = 0; i < ITERS; i++)
+        fat_write_file(name, buf, sizeof(buf), 0);
+    t1 = r_cntvct();
+    bench_report("fat_write_512", ITERS, t1 - t0, (uint64)ITERS * sizeof(buf));
+
+    t0 = r_cntvct();
+    for(int i = 0; i < ITERS; i++)
+        fat_read_file(name, buf, sizeof(buf), 0);
+    t1 = r_cntvct();
+    bench_report("fat_read_512", ITERS, t1 - t0, (uint64)ITERS * sizeof(buf));
+
+    // 读 0 字节只做目录查找
+    name[5] = '0' + NFILES - 1;
+    t0 = r_cntvct();
+    for(int i = 0; i < ITERS; i++)
+        fat_read_file(name, buf, 0, 0);
+    t1 = r_cntvct();
+    bench_report("fat_lookup", ITERS, t1 - t0, 0);
+}
+
+// 输出两次统计之间块层的请求数、被并进已有请求的比例和实际发给驱动的请求数
+static void blk_merge_report(const char *name, struct blk_stats *a, struct blk_stats *b) {
+    uint64 reqs = b->reqs - a->reqs, merges = b->merges - a->merges;
+    pr_info("{\"bench\":\"%s\",\"reqs\":%lu,\"merges\":%lu,\"dispatched\":%lu,\"merge_pct\":%lu}\n",
+            name, reqs, merges, b->dispatched - a->dispatched, reqs ? merges * 100 / reqs : 0);
+    log_flush();
+}
+
+// 在设备 d 上用调度器 sched 跑 FAT 负载：整体写入再读回 64KB 文件（整扇区成批提交，可以合并），
+// 以及 512 字节小文件的写读（FAT 表的单扇区访问，基本不能合并）。读用 fat_read_direct 绕过页缓存，测的是块层和设备
+static void blk_fat_workload(struct blk_dev *d, const char *sched) {
+    enum { ITERS = 50, SIZE = 65536 };
+    char name[64];
+    struct blk_stats a, b;
+    char *buf = alloc_pages(SIZE / PAGE_SIZE);
+    if(!buf || blk_set_sched(d, sched) != 0 || fat_mount(d) != 0) {
+        pr_err("bench: cannot set up %s/%s\n", d->name, sched);
+        if(buf)
+            free_pages(buf, SIZE / PAGE_SIZE);
+        return;
+    }
+    memset(buf, 's', SIZE);
+
+    blk_get_stats(d, &a);
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < ITERS; i++)
+        fat_write_file("BLKSEQ  BIN", buf, SIZE, 0);
+    uint64 t1 = r_cntvct();
+    for(int i = 0; i < ITERS; i++)
+        fat_read_direct("BLKSEQ  BIN", buf, SIZE, 0);
+    uint64 t2 = r_cntvct();
+    blk_get_stats(d, &b);
+    snprintf(name, sizeof(name), "blk_%s_%s_write_64k", d->name, sched);
+    bench_report(name, ITERS, t1 - t0, (uint64)ITERS * SIZE);
+    snprintf(name, sizeof(name), "blk_%s_%s_read_64k", d->name, sched);
+    bench_report(name, ITERS, t2 - t1, (uint64)ITERS * SIZE);
+    snprintf(name, sizeof(name), "blk_%s_%s_merge_seq", d->name, sched);
+    blk_merge_report(name, &a, &b);
+
+    a = b;
+    t0 = r_cntvct();
+    for(int i = 0; i < ITERS; i++) {
+        fat_write_file("BLKSMALLTXT", buf, 512, 0);
+        fat_read_direct("BLKSMALLTXT", buf, 512, 0);
+    }
+    t1 = r_cntvct();
+    blk_get_stats(d, &b);
+    snprintf(name, sizeof(name), "blk_%s_%s_small_512", d->name, sched);
+    bench_report(name, ITERS, t1 - t0, (uint64)ITERS * 1024);
+    snprintf(name, sizeof(name), "blk_%s_%s_merge_small", d->name, sched);
+    blk_merge_report(name, &a, &b);
+    free_pages(buf, SIZE / PAGE_SIZE);
+}
+
+// 块层：把整个磁盘拷进内存盘 ram0，同一组 FAT 负载在 virtio 磁盘和内存盘上各用 noop 和 deadline 运行，
+// 内存盘上的结果不含 virtio 的开销。结束后文件系统挂回 virtio 磁盘
+static void bench_blk(void) {
+    static const char *scheds[] = { "noop", "deadline" };
+    struct blk_dev *vda = blk_lookup("vda");
+    if(!vda || vda->nsectors == 0)
+        return;
+    struct blk_dev *ram = ramdisk_create(vda->nsectors);
+    char *buf = alloc_pages(16);
+    if(!ram || !buf) {
+        if(buf)
+            free_pages(buf, 16);
+        return;
+    }
+    for(uint64 s = 0; s < vda->nsectors; s += BLK_MAX_SECTORS) {
+        uint32 n = vda->nsectors - s < BLK_MAX_SECTORS ? vda->nsectors - s : BLK_MAX_SECTORS;
+        if(blk_rw(vda, buf, s, n, 0) != 0 || blk_rw(ram, buf, s, n, 1) != 0) {
+            pr_err("bench: ramdisk copy failed at sector %lu\n", s);
+            free_pages(buf, 16);
+            return;
+        }
+    }
+    free_pages(buf, 16);
+
+    struct blk_dev *devs[] = { vda, ram };
+    for(int i = 0; i < 2; i++) {
+        for(int j = 0; j < 2; j++)
+            blk_fat_workload(devs[i], scheds[j]);
+    }
+    blk_set_sched(vda, "deadline");
+    fat_mount(vda);
+}
+
+static struct bench benches[] = {
+    { "page_alloc_1", bench_page_alloc_1 },
+    { "page_alloc_16", bench_page_alloc_16 },
+    { "page_alloc_batch", bench_page_alloc_batch },
+    { "page_alloc_zero", bench_page_alloc_zero },
+    { "ctx_switch", bench_ctx_switch },
+    { "ctx_switch_fpsimd", bench_ctx_switch_fpsimd },
+    { "user_switch", bench_user_switch },
+    { "user_stack", bench_user_stack },
+    { "fork", bench_fork },
+    { "kernel_map", bench_kernel_map },
+    { "mmap", bench_mmap },
+    { "idle", bench_idle },
+    { "fair", bench_fair },
+    { "timer", bench_timer },
+    { "pid", bench_pid },
+    { "ipc", bench_ipc },
+    { "call", bench_call },
+    { "ioring", bench_ioring },
+    { "checksum", bench_checksum },
+    { "memcpy", bench_memcpy },
+    { "virtio_iops", bench_virtio_iops },
+    { "virtio_seq", bench_virtio_seq },
+    { "fat", bench_fat },
+    { "blk", bench_blk },
+};
+
+// 在进程上下文中依次运行所有测试
+static void bench_run(void) {
+    pr_info("{\"bench_suite\":\"start\",\"cntfrq\":%lu}\n", r_cntfrq());
+    for(uint32 i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+        benches[i].fn();
+    pr_info("{\"bench_suite\":\"done\",\"log_dropped\":%lu}\n", log_dropped());
+    psci_system_off();
+}
+
+// 创建测试进程，由 kinit 在设备和文件系统就绪后调用
+void bench_start(void) {
+    struct proc *p = kthread_create(bench_run);
+    if(!p)
+        panic("bench: cannot create runner");
+    proc_ready(p);
+}
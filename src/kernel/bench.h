@@ -0,0 +1,11 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "types.h"
+
+// 函数声明
+void bench_start(void);
+void bench_report(const char *name, uint64 iters, uint64 ticks, uint64 bytes);
+uint64 ticks_to_ns(uint64 ticks);
+
+#endif
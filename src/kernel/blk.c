@@ -0,0 +1,328 @@
+#include "blk.h"
+
+#ifndef HOST_COMPAT
+#include "aarch64.h"
+#include "proc.h"
+#include "timer.h"
+#include "wait.h"
+// 只有一个核，队列只需防止完成中断打断
+#define blk_lock()          push_off()
+#define blk_unlock()        pop_off()
+#define blk_wait(wq, cond)  wait_event(wq, cond)
+#define blk_wake(wq)        wake_all(wq)
+#define blk_now()           r_cntvct()
+#define blk_ms(ms)          ns_to_ticks((ms) * 1000000UL)
+#endif
+
+// deadline 调度器：读最多等 50ms，写最多等 500ms
+#define READ_EXPIRE_MS  50
+#define WRITE_EXPIRE_MS 500
+
+static struct blk_dev *devs;
+
+static int name_eq(const char *a, const char *b) {
+    while(*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+// noop：按到达顺序发出，只做合并
+static void noop_add(struct blk_dev *d, struct blk_req *r) {
+    struct blk_req **pp = &d->queue;
+    while(*pp)
+        pp = &(*pp)->next;
+    *pp = r;
+}
+
+static struct blk_req *noop_next(struct blk_dev *d) {
+    struct blk_req *r = d->queue;
+    if(r)
+        d->queue = r->next;
+    return r;
+}
+
+// deadline：队列按起始扇区排序，从上一个请求的结束处向前扫描（C-SCAN），
+// 同时读写各有一条到达顺序的链，链头超时就先发它，避免请求饿死
+static void deadline_add(struct blk_dev *d, struct blk_req *r) {
+    struct blk_req **pp = &d->queue;
+    while(*pp && (*pp)->start < r->start)
+        pp = &(*pp)->next;
+    r->next = *pp;
+    *pp = r;
+
+    r->expire = blk_now() + (r->op == BLK_READ ? blk_ms(READ_EXPIRE_MS) : blk_ms(WRITE_EXPIRE_MS));
+    pp = &d->fifo[r->op];
+    while(*pp)
+        pp = &(*pp)->fifo_next;
+    *pp = r;
+}
+
+static void list_remove(struct blk_req **pp, struct blk_req *r, int fifo) {
+    for(; *pp; pp = fifo ? &(*pp)->fifo_next : &(*pp)->next) {
+        if(*pp == r) {
+            *pp = fifo ? r->fifo_next : r->next;
+            return;
+        }
+    }
+}
+
+static struct blk_req *deadline_next(struct blk_dev *d) {
+    if(!d->queue)
+        return 0;
+    struct blk_req *r = 0;
+    uint64 now = blk_now();
+    for(int op = BLK_READ; op <= BLK_WRITE && !r; op++) {
+        if(d->fifo[op] && now >= d->fifo[op]->expire)
+            r = d->fifo[op];
+    }
+    if(!r) {
+        for(r = d->queue; r && r->start < d->last_sector; r = r->next)
+            ;
+        // 扫到末尾，回到最低的扇区
+        if(!r)
+            r = d->queue;
+    }
+    list_remove(&d->queue, r, 0);
+    list_remove(&d->fifo[r->op], r, 1);
+    d->last_sector = r->start + r->total;
+    return r;
+}
+
+static const struct blk_sched scheds[] = {
+    { "noop", noop_add, noop_next },
+    { "deadline", deadline_add, deadline_next },
+};
+
+static const struct blk_sched *sched_find(const char *name) {
+    for(int i = 0; i < sizeof(scheds) / sizeof(scheds[0]); i++) {
+        if(name_eq(scheds[i].name, name))
+            return &scheds[i];
+    }
+    return 0;
+}
+
+// 注册设备，sched 为初始调度器的名字，找不到时用 noop
+void blk_register(struct blk_dev *d, const char *sched) {
+    d->sched = sched_find(sched);
+    if(!d->sched)
+        d->sched = &scheds[0];
+    d->queue = d->fifo[0] = d->fifo[1] = 0;
+    d->retry = 0;
+    d->flush_head = d->flush_tail = 0;
+    d->held_head = d->held_tail = 0;
+    d->last_sector = 0;
+    d->inflight = d->plugged = d->running = 0;
+    d->stats = (struct blk_stats){ 0 };
+    d->next_dev = devs;
+    devs = d;
+}
+
+struct blk_dev *blk_lookup(const char *name) {
+    for(struct blk_dev *d = devs; d; d = d->next_dev) {
+        if(name_eq(d->name, name))
+            return d;
+    }
+    return 0;
+}
+
+// 切换调度器，只在队列为空时允许，成功返回 0
+int blk_set_sched(struct blk_dev *d, const char *name) {
+    const struct blk_sched *s = sched_find(name);
+    int ret = -1;
+    blk_lock();
+    if(s && !d->queue) {
+        d->sched = s;
+        ret = 0;
+    }
+    blk_unlock();
+    return ret;
+}
+
+// 把 r 并进队列中首尾相接的同向请求，成功返回 1。队列中的请求还没发给驱动，可以随意扩展
+static int blk_merge(struct blk_dev *d, struct blk_req *r) {
+    for(struct blk_req *q = d->queue; q; q = q->next) {
+        if(q->op != r->op || q->nseg >= BLK_MAX_SEGS || q->total + r->nsect > BLK_MAX_SECTORS)
+            continue;
+        if(q->start + q->total == r->sector) {
+            q->last->seg = r;
+            q->last = r;
+        } else if(r->sector + r->nsect == q->start) {
+            r->seg = q->first;
+            q->first = r;
+            q->start = r->sector;
+        } else {
+            continue;
+        }
+        q->total += r->nsect;
+        q->nseg++;
+        d->stats.merges++;
+        return 1;
+    }
+    return 0;
+}
+
+static void blk_queue(struct blk_dev *d, struct blk_req *r) {
+    if(!blk_merge(d, r))
+        d->sched->add(d, r);
+}
+
+static void list_append(struct blk_req **head, struct blk_req **tail, struct blk_req *r) {
+    r->next = 0;
+    if(*tail)
+        (*tail)->next = r;
+    else
+        *head = r;
+    *tail = r;
+}
+
+// 把请求交给驱动，直到队列空或驱动收不下，调用者需持有 blk_lock。
+// force 为 0 时尊重 plug；驱动在 submit 里同步完成请求时会重入，由 running 挡住
+static void blk_run(struct blk_dev *d, int force) {
+    if(d->running)
+        return;
+    d->running = 1;
+    while(force || !d->plugged) {
+        struct blk_req *r = d->retry;
+        d->retry = 0;
+        if(!r)
+            r = d->sched->next(d);
+        if(!r && d->flush_head && d->inflight == 0) {
+            // 前面的请求都已完成，发出 FLUSH
+            r = d->flush_head;
+            d->flush_head = r->next;
+            if(!d->flush_head)
+                d->flush_tail = 0;
+        }
+        if(!r)
+            break;
+        d->inflight++;
+        if(d->submit(d, r) < 0) {
+            d->inflight--;
+            d->retry = r;
+            break;
+        }
+        d->stats.dispatched++;
+    }
+    d->running = 0;
+}
+
+// 提交请求，完成时调用 r->done
+void blk_submit(struct blk_dev *d, struct blk_req *r) {
+    r->next = r->fifo_next = r->seg = 0;
+    r->first = r->last = r;
+    r->start = r->sector;
+    r->total = r->op == BLK_FLUSH ? 0 : r->nsect;
+    r->nseg = 1;
+    blk_lock();
+    d->stats.reqs++;
+    d->stats.sectors += r->total;
+    if(r->op == BLK_FLUSH)
+        list_append(&d->flush_head, &d->flush_tail, r);
+    else if(d->flush_head)
+        list_append(&d->held_head, &d->held_tail, r);
+    else
+        blk_queue(d, r);
+    blk_run(d, 0);
+    blk_unlock();
+}
+
+// 驱动完成请求 r：按顺序完成它的每一段，再继续发出排队的请求。可以在中断处理中调用
+void blk_end(struct blk_dev *d, struct blk_req *r, int status) {
+    blk_lock();
+    d->inflight--;
+    int flush = r->op == BLK_FLUSH;
+    for(struct blk_req *s = r->first, *next; s; s = next) {
+        // done 可能让提交者重用请求，先取出下一段
+        next = s->seg;
+        s->status = status;
+        s->done(s);
+    }
+    if(flush && !d->flush_head) {
+        // 最后一个 FLUSH 已完成，它之后到达的请求进入调度器
+        struct blk_req *h = d->held_head;
+        d->held_head = d->held_tail = 0;
+        while(h) {
+            struct blk_req *next = h->next;
+            h->next = 0;
+            blk_queue(d, h);
+            h = next;
+        }
+    }
+    blk_run(d, 1);
+    blk_unlock();
+}
+
+// 驱动有了空闲资源（例如描述符）时调用，重新发出排队的请求
+void blk_kick(struct blk_dev *d) {
+    blk_lock();
+    blk_run(d, 1);
+    blk_unlock();
+}
+
+// plug 到 unplug 之间提交的请求先留在队列里，unplug 时一起发出，相邻的请求有机会合并。可以嵌套
+void blk_plug(struct blk_dev *d) {
+    blk_lock();
+    d->plugged++;
+    blk_unlock();
+}
+
+void blk_unplug(struct blk_dev *d) {
+    blk_lock();
+    if(--d->plugged == 0)
+        blk_run(d, 0);
+    blk_unlock();
+}
+
+struct blk_batch {
+    int left;
+    int err;
+#ifndef HOST_COMPAT
+    struct wait_queue wq;
+#endif
+};
+
+static void batch_done(struct blk_req *r) {
+    struct blk_batch *b = r->priv;
+    if(r->status)
+        b->err = 1;
+    if(--b->left == 0)
+        blk_wake(&b->wq);
+}
+
+// 一次提交 n 个请求并睡眠等它们全部完成，任一失败返回 -1。
+// 睡眠前不论外层是否 plug 都把队列发出去，否则外层 plug 的持有者会等自己
+int blk_submit_wait(struct blk_dev *d, struct blk_req *reqs, int n) {
+    struct blk_batch b = { .left = n };
+#ifndef HOST_COMPAT
+    wait_queue_init(&b.wq);
+#endif
+    blk_plug(d);
+    for(int i = 0; i < n; i++) {
+        reqs[i].done = batch_done;
+        reqs[i].priv = &b;
+        blk_submit(d, &reqs[i]);
+    }
+    blk_unplug(d);
+    blk_kick(d);
+    blk_wait(&b.wq, b.left == 0);
+    return b.err ? -1 : 0;
+}
+
+// 同步读写 nsect 个连续扇区
+int blk_rw(struct blk_dev *d, void *buf, uint32 sector, uint32 nsect, int write) {
+    struct blk_req r = {
+        .buf = buf,
+        .sector = sector,
+        .nsect = nsect,
+        .op = write ? BLK_WRITE : BLK_READ,
+    };
+    return blk_submit_wait(d, &r, 1);
+}
+
+void blk_get_stats(struct blk_dev *d, struct blk_stats *st) {
+    blk_lock();
+    *st = d->stats;
+    blk_unlock();
+}
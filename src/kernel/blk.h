@@ -0,0 +1,89 @@
+#ifndef _BLK_H
+#define _BLK_H
+
+#include "types.h"
+
+// 通用块层：文件系统和 I/O 环把扇区请求交给 blk_submit，块层放进设备的请求队列，
+// 与队列中相邻的同向请求合并成一个多段请求，由调度器决定发给驱动的顺序。
+// 驱动只实现 submit：把一个（可能合并过的）请求交给硬件，完成时调用 blk_end
+#define BLK_READ  0
+#define BLK_WRITE 1
+#define BLK_FLUSH 2   // 刷新设备写缓存，等之前的请求全部完成才发出，之后的请求等它完成
+
+#define BLK_MAX_SEGS    16    // 一个合并请求最多的段数
+#define BLK_MAX_SECTORS 128   // 一个合并请求最多的扇区数（64KB）
+
+// 请求：提交者填写 buf、sector、nsect、op、done、priv，完成时在中断处理（或驱动的提交路径）中调用 done
+struct blk_req {
+    char *buf;              // 数据缓冲区（内核地址），FLUSH 不用
+    uint32 sector;
+    uint32 nsect;
+    int op;                 // BLK_READ/WRITE/FLUSH
+    int status;             // 完成时填写，0 表示成功
+    void (*done)(struct blk_req *r);
+    void *priv;             // 留给提交者
+
+    // 以下由块层填写。请求在队列中时，first..last 是按扇区顺序经 seg 连起来的全部段（包括它自己），
+    // 覆盖 [start, start + total)；驱动按这条链传输
+    struct blk_req *next;         // 队列链接
+    struct blk_req *fifo_next;    // deadline 调度器的到达顺序链接
+    struct blk_req *first, *last, *seg;
+    uint32 start;
+    uint32 total;
+    uint32 nseg;
+    uint64 expire;                // deadline 调度器：最晚的发出时间
+};
+
+struct blk_dev;
+
+// I/O 调度器：add 把没能合并的请求放进队列，next 取出下一个发给驱动的请求
+struct blk_sched {
+    const char *name;
+    void (*add)(struct blk_dev *d, struct blk_req *r);
+    struct blk_req *(*next)(struct blk_dev *d);
+};
+
+struct blk_stats {
+    uint64 reqs;            // 提交的请求
+    uint64 merges;          // 并进已有请求的请求
+    uint64 dispatched;      // 发给驱动的请求
+    uint64 sectors;
+};
+
+// 块设备：驱动填写 name、nsectors、submit、priv 后 blk_register。
+// submit 返回 -1 表示驱动暂时收不下（例如描述符用完），块层留着这个请求，等驱动调用 blk_kick 再试
+struct blk_dev {
+    const char *name;
+    uint64 nsectors;
+    int (*submit)(struct blk_dev *d, struct blk_req *r);
+    void *priv;
+
+    // 以下由块层使用
+    const struct blk_sched *sched;
+    struct blk_req *queue;                  // 调度器的队列
+    struct blk_req *fifo[2];                // deadline：读、写各自按到达顺序
+    uint32 last_sector;                     // deadline：上一个发出的请求的结束扇区
+    struct blk_req *retry;                  // 驱动上次没收下的请求
+    struct blk_req *flush_head, *flush_tail;  // 等前面的请求完成的 FLUSH
+    struct blk_req *held_head, *held_tail;    // FLUSH 之后到达的请求
+    int inflight;                           // 在驱动中的请求
+    int plugged;                            // 大于 0 时新请求只排队不发出，攒够了一起合并
+    int running;
+    struct blk_stats stats;
+    struct blk_dev *next_dev;
+};
+
+// 函数声明
+void blk_register(struct blk_dev *d, const char *sched);
+struct blk_dev *blk_lookup(const char *name);
+int blk_set_sched(struct blk_dev *d, const char *name);
+void blk_submit(struct blk_dev *d, struct blk_req *r);
+void blk_end(struct blk_dev *d, struct blk_req *r, int status);
+void blk_kick(struct blk_dev *d);
+void blk_plug(struct blk_dev *d);
+void blk_unplug(struct blk_dev *d);
+int blk_submit_wait(struct blk_dev *d, struct blk_req *reqs, int n);
+int blk_rw(struct blk_dev *d, void *buf, uint32 sector, uint32 nsect, int write);
+void blk_get_stats(struct blk_dev *d, struct blk_stats *st);
+
+#endif
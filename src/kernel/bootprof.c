@@ -0,0 +1,38 @@
+#include "bootprof.h"
+#include "aarch64.h"
+#include "printk.h"
+
+#define BOOT_MAX_PHASES 16
+
+uint64 boot_cntpct;
+
+// 每个阶段结束时的计数值
+static struct {
+    const char *name;
+    uint64 ts;
+} phases[BOOT_MAX_PHASES];
+static int nphases;
+
+// 记录一个启动阶段在此刻结束
+void boot_mark(const char *phase) {
+    if(nphases < BOOT_MAX_PHASES) {
+        phases[nphases].name = phase;
+        phases[nphases].ts = r_cntpct();
+        nphases++;
+    }
+}
+
+static uint64 ticks_to_us(uint64 ticks) {
+    return ticks * 1000000 / r_cntfrq();
+}
+
+// 打印各阶段耗时，时间从 _start 第一条指令算起
+void boot_report(void) {
+    pr_info("[boot] reset -> _start: %lu us\n", ticks_to_us(boot_cntpct));
+    uint64 prev = boot_cntpct;
+    for(int i = 0; i < nphases; i++) {
+        pr_info("[boot] %-20s %8lu us  (at %8lu us)\n", phases[i].name,
+                ticks_to_us(phases[i].ts - prev), ticks_to_us(phases[i].ts - boot_cntpct));
+        prev = phases[i].ts;
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef _BOOTPROF_H
+#define _BOOTPROF_H
+
+#include "types.h"
+
+// boot.S 第一条指令读到的 CNTPCT_EL0
+extern uint64 boot_cntpct;
+
+// 函数声明
+void boot_mark(const char *phase);
+void boot_report(void);
+
+#endif
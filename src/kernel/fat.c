@@ -1,7 +1,10 @@
 #include "fat.h"
-#include "virtio_blk.h"
+#include "blk.h"
+#include "pagecache.h"
+#include "vm.h"
 #include "uart.h"
 #include "mm.h"
+#include "trace.h"
 
 static struct fat_bpb bpb;
 static uint32 fat_start_sector;
@@ -12,16 +15,46 @@ static uint32 sectors_per_fat;
 static uint32 bytes_per_sector;
 static uint8 sectors_per_cluster;
 static uint8 num_fats;
+static struct blk_dev *dev;
+// 根目录第一个扇区的副本：文件查找只看这一个扇区，命中页缓存的读不访问设备
+static uint8 root_buf[512];
+static int root_valid;
+
+// 整扇区的读写一次最多攒这么多个请求交给块层，相邻扇区在队列里合并
+#define FAT_BATCH 16
 
 static int read_sector(uint32 sector, void *buf) {
-    return virtio_blk_rw((char*)buf, sector, 0);
+    if (sector == root_dir_sector && root_valid) {
+        memcpy(buf, root_buf, 512);
+        return 0;
+    }
+    int r = blk_rw(dev, buf, sector, 1, 0);
+    if (r == 0 && sector == root_dir_sector) {
+        memcpy(root_buf, buf, 512);
+        root_valid = 1;
+    }
+    return r;
 }
 static int write_sector(uint32 sector, const void *buf) {
-    return virtio_blk_rw((char*)buf, sector, 1);
+    int r = blk_rw(dev, (void*)buf, sector, 1, 1);
+    if (sector == root_dir_sector) {
+        if (r == 0) memcpy(root_buf, buf, 512);
+        root_valid = r == 0;
+    }
+    return r;
 }
 
 int fat_init() {
+    return fat_mount(blk_lookup("vda"));
+}
+
+// 挂载块设备 d 上的文件系统，之后的文件操作都在它上面进行
+int fat_mount(struct blk_dev *d) {
     uint8 buf[512];
+    if (!d) return -1;
+    // 页缓存按文件名索引，换设备前写回并清空
+    if (dev && dev != d && pcache_drop() != 0) return -1;
+    dev = d;
     if (read_sector(0, buf) != 0) return -1;
     memcpy(&bpb, buf, sizeof(struct fat_bpb));
     bytes_per_sector = bpb.bytes_per_sector;
@@ -32,6 +65,7 @@ int fat_init() {
     root_dir_sectors = ((bpb.root_entries * 32) + (bytes_per_sector - 1)) / bytes_per_sector;
     root_dir_sector = fat_start_sector + num_fats * sectors_per_fat;
     data_start_sector = root_dir_sector + root_dir_sectors;
+    root_valid = 0;
     return 0;
 }
 
@@ -120,6 +154,16 @@ static int set_fat_entry(uint32 cluster, uint16 val) {
     return 0;
 }
 
+// 把簇 cl 清零：用一块清零的页作为缓冲区，整簇一个请求写出
+static int zero_cluster(uint32 cl) {
+    uint32 npages = PGROUNDUP(sectors_per_cluster * 512) / PAGE_SIZE;
+    void *zero = alloc_pages_flags(npages, ALLOC_ZERO);
+    if (!zero) return -1;
+    int r = blk_rw(dev, zero, data_start_sector + (cl - 2) * sectors_per_cluster, sectors_per_cluster, 1);
+    free_pages(zero, npages);
+    return r;
+}
+
 // 创建根目录新文件
 static int create_file_in_root(const char *name, struct fat_dir_entry *entry) {
     int idx;
@@ -149,35 +193,118 @@ static int create_file_in_root(const char *name, struct fat_dir_entry *entry) {
     if (write_sector(root_dir_sector, buf) != 0) return -1;
     if (entry) *entry = new_entry;
     // 清空新簇
-    uint8 zero[512] = {0};
-    for (uint8 i = 0; i < sectors_per_cluster; i++) {
-        uint32 sector = data_start_sector + (cl - 2) * sectors_per_cluster + i;
-        write_sector(sector, zero);
-    }
+    zero_cluster(cl);
     return 0;
 }
 
-int fat_read_file(const char *name, void *buf, uint32 size, uint32 offset) {
-    struct fat_dir_entry entry;
-    if (find_file_in_root(name, &entry) != 0) return -1;
-    uint32 cluster = (entry.first_cluster_high << 16) | entry.first_cluster_low;
-    uint32 file_offset = 0;
-    uint32 remain = size;
+// 在簇链末尾的 cluster 后面接一个新簇，返回新簇号，磁盘满或出错时返回 0。
+// zero 非 0 时把新簇清零：它有一部分落在文件的空洞里，不会被这次写入覆盖。
+// 出错时把已经标记的新簇放回空闲，不留下不在任何簇链上的簇
+static uint32 chain_extend(uint32 cluster, int zero) {
+    uint32 next = find_free_cluster();
+    if (next == 0) return 0;
+    if (set_fat_entry(next, 0xFFF8) != 0) goto bad;
+    if (zero && zero_cluster(next) != 0) goto bad;
+    if (set_fat_entry(cluster, next) != 0) goto bad;
+    return next;
+bad:
+    set_fat_entry(next, 0);
+    return 0;
+}
+
+// 沿簇链从文件内偏移 offset 处读写 size 字节，返回实际传输的字节数，出错返回 -1。
+// extend 非 0 时写到簇链末尾会分配新簇接上，否则在簇链末尾停止。
+// 写入不足一个扇区且不从文件开头写时，先读出扇区再修改，保留扇区里的其他数据
+static int fat_chain_rw(uint32 cluster, uint8 *buf, uint32 size, uint32 offset, int write, int extend) {
+    uint32 cluster_bytes = sectors_per_cluster * 512;
+    int rmw = offset != 0;
+    while (cluster >= 2 && cluster < 0xFFF8 && offset >= cluster_bytes) {
+        offset -= cluster_bytes;
+        uint32 next = get_fat_entry(cluster);
+        if (next >= 0xFFF8 && write && extend && size > 0) {
+            // 写入位置在簇链之后（例如在簇边界上追加），先把簇链接长
+            next = chain_extend(cluster, offset != 0);
+            if (next == 0) return 0;
+        }
+        cluster = next;
+    }
+    uint32 done = 0;
     uint8 sector_buf[512];
-    while (cluster >= 2 && cluster < 0xFFF8 && remain > 0) {
-        for (uint8 i = 0; i < sectors_per_cluster && remain > 0; i++) {
+    struct blk_req reqs[FAT_BATCH];
+    int nreq = 0;
+    while (cluster >= 2 && cluster < 0xFFF8 && done < size) {
+        if (!write)
+            trace(TRACE_FAT_CLUSTER_READ, cluster, data_start_sector + (cluster - 2) * sectors_per_cluster);
+        for (uint32 i = offset / 512; i < sectors_per_cluster && done < size; i++) {
             uint32 sector = data_start_sector + (cluster - 2) * sectors_per_cluster + i;
-            if (read_sector(sector, sector_buf) != 0) return -1;
-            uint32 to_copy = (remain > 512) ? 512 : remain;
-            memcpy((uint8*)buf + file_offset, sector_buf, to_copy);
-            file_offset += to_copy;
-            remain -= to_copy;
+            uint32 sec_off = offset % 512;
+            uint32 n = 512 - sec_off;
+            if (n > size - done) n = size - done;
+            if (n == 512) {
+                // 整扇区直接读写调用者的缓冲区，成批提交
+                reqs[nreq].buf = (char*)buf + done;
+                reqs[nreq].sector = sector;
+                reqs[nreq].nsect = 1;
+                reqs[nreq].op = write ? BLK_WRITE : BLK_READ;
+                if (++nreq == FAT_BATCH) {
+                    if (blk_submit_wait(dev, reqs, nreq) != 0) return -1;
+                    nreq = 0;
+                }
+            } else if (write) {
+                if (rmw && read_sector(sector, sector_buf) != 0) return -1;
+                memcpy(sector_buf + sec_off, buf + done, n);
+                if (write_sector(sector, sector_buf) != 0) return -1;
+            } else {
+                if (read_sector(sector, sector_buf) != 0) return -1;
+                memcpy(buf + done, sector_buf + sec_off, n);
+            }
+            done += n;
+            offset = 0;
         }
-        cluster = get_fat_entry(cluster);
+        uint32 next = get_fat_entry(cluster);
+        if (next >= 0xFFF8 && write && extend && done < size) {
+            // 簇链用完，分配新簇接到末尾
+            next = chain_extend(cluster, 0);
+            if (next == 0) break;
+        }
+        cluster = next;
     }
-    return file_offset;
+    // 连续的簇在磁盘上相邻时，跨簇的扇区同样能合并
+    if (nreq && blk_submit_wait(dev, reqs, nreq) != 0) return -1;
+    return done;
+}
+
+// 读文件经过页缓存：命中的页直接拷贝，不访问设备；缓存放不下时退回直接读。
+// 只读到文件末尾，返回读到的字节数
+int fat_read_file(const char *name, void *buf, uint32 size, uint32 offset) {
+    struct fat_dir_entry entry;
+    if (find_file_in_root(name, &entry) != 0) return -1;
+    if (offset >= entry.size) return 0;
+    if (size > entry.size - offset) size = entry.size - offset;
+    uint32 done = 0;
+    while (done < size) {
+        uint32 pos = offset + done;
+        uint32 n = PAGE_SIZE - pos % PAGE_SIZE;
+        if (n > size - done) n = size - done;
+        uint8 *page = pcache_get(name, pos / PAGE_SIZE);
+        if (page)
+            memcpy((uint8*)buf + done, page + pos % PAGE_SIZE, n);
+        else if (fat_read_direct(name, (uint8*)buf + done, n, pos) != (int)n)
+            return done ? (int)done : -1;
+        done += n;
+    }
+    return done;
+}
+
+// 绕过页缓存直接从设备读，页缓存自己缺页时用
+int fat_read_direct(const char *name, void *buf, uint32 size, uint32 offset) {
+    struct fat_dir_entry entry;
+    if (find_file_in_root(name, &entry) != 0) return -1;
+    uint32 cluster = (entry.first_cluster_high << 16) | entry.first_cluster_low;
+    return fat_chain_rw(cluster, buf, size, offset, 0, 0);
 }
 
+// 写文件直接写到设备，再把写入的数据拷进已缓存的页，缓存和磁盘保持一致
 int fat_write_file(const char *name, const void *buf, uint32 size, uint32 offset) {
     struct fat_dir_entry entry;
     if (find_file_in_root(name, &entry) != 0) {
@@ -185,30 +312,60 @@ int fat_write_file(const char *name, const void *buf, uint32 size, uint32 offset
         if (create_file_in_root(name, &entry) != 0) return -1;
     }
     uint32 cluster = (entry.first_cluster_high << 16) | entry.first_cluster_low;
-    uint32 file_offset = 0;
-    uint32 remain = size;
-    uint8 sector_buf[512];
-    while (cluster >= 2 && cluster < 0xFFF8 && remain > 0) {
-        for (uint8 i = 0; i < sectors_per_cluster && remain > 0; i++) {
-            uint32 sector = data_start_sector + (cluster - 2) * sectors_per_cluster + i;
-            uint32 to_copy = (remain > 512) ? 512 : remain;
-            memcpy(sector_buf, (const uint8*)buf + file_offset, to_copy);
-            if (write_sector(sector, sector_buf) != 0) return -1;
-            file_offset += to_copy;
-            remain -= to_copy;
-        }
-        cluster = get_fat_entry(cluster);
-    }
-    // 更新文件大小
+    int written = fat_chain_rw(cluster, (uint8*)buf, size, offset, 1, 1);
+    if (written < 0) return -1;
+    // 更新文件大小：按实际写入的字节数，从头写入时以本次写入为准，否则只会变大
     uint8 dir_buf[512];
     if (read_sector(root_dir_sector, dir_buf) != 0) return -1;
     struct fat_dir_entry *entries = (struct fat_dir_entry*)dir_buf;
     for (int i = 0; i < 16; i++) {
         if (memcmp(entries[i].name, name, 11) == 0) {
-            entries[i].size = size;
+            if (offset == 0)
+                entries[i].size = written;
+            else if (written > 0 && offset + written > entries[i].size)
+                entries[i].size = offset + written;
             break;
         }
     }
     if (write_sector(root_dir_sector, dir_buf) != 0) return -1;
-    return file_offset;
-} 
\ No newline at end of file
+    pcache_update(name, buf, written, offset);
+    return written;
+}
+
+// 改写文件已有的数据：不分配新簇，也不改变文件大小，用于页缓存写回
+int fat_write_range(const char *name, const void *buf, uint32 size, uint32 offset) {
+    struct fat_dir_entry entry;
+    if (find_file_in_root(name, &entry) != 0) return -1;
+    if (offset >= entry.size) return 0;
+    if (size > entry.size - offset) size = entry.size - offset;
+    uint32 cluster = (entry.first_cluster_high << 16) | entry.first_cluster_low;
+    return fat_chain_rw(cluster, (uint8*)buf, size, offset, 1, 0);
+}
+
+// 返回文件大小，文件不存在时返回 -1
+int fat_file_size(const char *name) {
+    struct fat_dir_entry entry;
+    if (find_file_in_root(name, &entry) != 0) return -1;
+    return entry.size;
+}
+
+// 展开文件的簇链：前 max 个簇的起始扇区依次写入 sectors，返回簇数（超过 max 时只填 max 个），
+// 文件大小和每簇扇区数由 size、spc 带回。文件不存在时返回 -1
+int fat_file_map(const char *name, uint32 *sectors, int max, uint32 *size, uint32 *spc) {
+    struct fat_dir_entry entry;
+    if (find_file_in_root(name, &entry) != 0) return -1;
+    uint32 cluster = (entry.first_cluster_high << 16) | entry.first_cluster_low;
+    int n = 0;
+    while (cluster >= 2 && cluster < 0xFFF8 && n < max) {
+        sectors[n++] = data_start_sector + (cluster - 2) * sectors_per_cluster;
+        cluster = get_fat_entry(cluster);
+    }
+    *size = entry.size;
+    *spc = sectors_per_cluster;
+    return n;
+}
+
+// 文件系统所在的块设备
+struct blk_dev *fat_device(void) {
+    return dev;
+}
@@ -36,10 +36,18 @@ struct fat_dir_entry {
     uint32 size;
 } __attribute__((packed));
 
+struct blk_dev;
+
 // 函数声明
 int fat_init();
+int fat_mount(struct blk_dev *d);
+struct blk_dev *fat_device(void);
 int fat_read_file(const char *name, void *buf, uint32 size, uint32 offset);
+int fat_read_direct(const char *name, void *buf, uint32 size, uint32 offset);
 int fat_write_file(const char *name, const void *buf, uint32 size, uint32 offset);
+int fat_write_range(const char *name, const void *buf, uint32 size, uint32 offset);
+int fat_file_size(const char *name);
+int fat_file_map(const char *name, uint32 *sectors, int max, uint32 *size, uint32 *spc);
 int fat_list_dir(const char *path, struct fat_dir_entry *entries, int max_entries);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "fpsimd.h"
+#include "aarch64.h"
+#include "mm.h"
+#include "proc.h"
+#include "trap.h"
+
+// 惰性切换：FP/SIMD 寄存器中保存的是 fp_owner 的状态。
+// 切换到其他进程时只关闭 FP 访问，该进程第一次使用 FP 时陷入，
+// 这时才保存旧属主的寄存器并装入新属主的寄存器。
+// 内核 C 代码使用 +nofp 编译，不会碰 FP 寄存器。
+
+#define CPACR_FPEN_MASK (3 << 20)
+#define CPACR_FPEN_TRAP (0 << 20)  // EL0 和 EL1 访问都陷入
+#define CPACR_FPEN_ON   (3 << 20)  // 不陷入
+
+// 每个 CPU 上 FP 寄存器当前属于哪个进程
+static struct proc *fp_owner[NCPU];
+
+static void fpsimd_set_access(uint64 fpen) {
+    uint64 cpacr;
+    asm volatile("mrs %0, cpacr_el1" : "=r" (cpacr));
+    if((cpacr & CPACR_FPEN_MASK) == fpen)
+        return;
+    cpacr = (cpacr & ~CPACR_FPEN_MASK) | fpen;
+    asm volatile("msr cpacr_el1, %0; isb" : : "r" (cpacr));
+}
+
+void fpsimd_init(void) {
+    fpsimd_set_access(CPACR_FPEN_TRAP);
+}
+
+// FP 访问陷入（ESR.EC = 0x07），返回后重新执行触发陷入的指令
+void fpsimd_trap(void) {
+    struct proc *p = myproc();
+    if(p == 0)
+        panic("fpsimd_trap: FP used outside a process");
+
+    fpsimd_set_access(CPACR_FPEN_ON);
+    struct proc *owner = fp_owner[cpuid()];
+    if(owner == p)
+        return;
+    if(owner)
+        fpsimd_save(&owner->fpsimd);
+    // 第一次使用时从全零状态开始
+    if(!p->fpsimd_used) {
+        memset(&p->fpsimd, 0, sizeof(p->fpsimd));
+        p->fpsimd_used = 1;
+    }
+    fpsimd_restore(&p->fpsimd);
+    fp_owner[cpuid()] = p;
+}
+
+// 切入进程前调用：只有寄存器属主可以不经陷入直接使用 FP
+void fpsimd_switch(struct proc *next) {
+    if(fp_owner[cpuid()] == next)
+        fpsimd_set_access(CPACR_FPEN_ON);
+    else
+        fpsimd_set_access(CPACR_FPEN_TRAP);
+}
+
+// 进程退出时放弃属主身份，寄存器内容作废
+void fpsimd_release(struct proc *p) {
+    for(int i = 0; i < NCPU; i++)
+        if(fp_owner[i] == p)
+            fp_owner[i] = 0;
+}
+
+// fork：子进程继承父进程的 FP/SIMD 状态，寄存器里的最新值先存回父进程
+void fpsimd_copy(struct proc *dst, struct proc *src) {
+    if(!src->fpsimd_used)
+        return;
+    if(fp_owner[cpuid()] == src)
+        fpsimd_save(&src->fpsimd);
+    memcpy(&dst->fpsimd, &src->fpsimd, sizeof(dst->fpsimd));
+    dst->fpsimd_used = 1;
+}
@@ -0,0 +1,26 @@
+#ifndef _FPSIMD_H
+#define _FPSIMD_H
+
+#include "types.h"
+
+struct proc;
+
+// 一个进程的 FP/SIMD 寄存器：32 个 128 位 Q 寄存器加 FPSR/FPCR
+struct fpsimd_state {
+    uint64 q[64];
+    uint64 fpsr;
+    uint64 fpcr;
+} __attribute__((aligned(16)));
+
+// 函数声明
+void fpsimd_init(void);
+void fpsimd_trap(void);
+void fpsimd_switch(struct proc *next);
+void fpsimd_release(struct proc *p);
+void fpsimd_copy(struct proc *dst, struct proc *src);
+
+// fpsimd.S
+void fpsimd_save(struct fpsimd_state *st);
+void fpsimd_restore(struct fpsimd_state *st);
+
+#endif
@@ -0,0 +1,95 @@
+#include "gic.h"
+#include "aarch64.h"
+#include "memlayout.h"
+
+// 分发器寄存器
+#define GICD_CTLR       0x0000
+#define GICD_IGROUPR    0x0080
+#define GICD_ISENABLER  0x0100
+#define GICD_IPRIORITYR 0x0400
+#define GICD_IROUTER    0x6000
+
+#define GICD_CTLR_ENGRP0 (1 << 0)
+#define GICD_CTLR_ENGRP1 (1 << 1)
+#define GICD_CTLR_ARE    (1 << 4)
+#define GICD_CTLR_RWP    (1U << 31)
+
+// 重分发器寄存器，每个 CPU 占两个 64KB 帧（RD_base + SGI_base）
+#define GICR_STRIDE     0x20000
+#define GICR_WAKER      0x0014
+#define GICR_SGI_BASE   0x10000
+#define GICR_IGROUPR0   (GICR_SGI_BASE + 0x0080)
+#define GICR_ISENABLER0 (GICR_SGI_BASE + 0x0100)
+#define GICR_IPRIORITYR (GICR_SGI_BASE + 0x0400)
+
+#define GICR_WAKER_SLEEP    (1 << 1)
+#define GICR_WAKER_ASLEEP   (1 << 2)
+
+// 所有中断使用同一优先级
+#define GIC_DEFAULT_PRIO 0xa0
+
+#define D(r)  ((volatile uint32 *)(GICD + (r)))
+#define R(r)  ((volatile uint32 *)(GICR + cpuid() * GICR_STRIDE + (r)))
+
+static void gicd_wait_rwp(void) {
+    while(*D(GICD_CTLR) & GICD_CTLR_RWP);
+}
+
+// 初始化分发器和当前核心的 CPU 接口
+void gic_init(void) {
+    // 关闭分发器后再配置
+    *D(GICD_CTLR) = 0;
+    gicd_wait_rwp();
+    *D(GICD_CTLR) = GICD_CTLR_ARE | GICD_CTLR_ENGRP1 | GICD_CTLR_ENGRP0;
+    gicd_wait_rwp();
+
+    gic_init_cpu();
+
+    // 启用设备中断
+    gic_enable_irq(UART0_IRQ);
+}
+
+// 唤醒重分发器并打开系统寄存器接口
+void gic_init_cpu(void) {
+    *R(GICR_WAKER) &= ~GICR_WAKER_SLEEP;
+    while(*R(GICR_WAKER) & GICR_WAKER_ASLEEP);
+
+    // 私有中断（SGI/PPI）全部归入 Group 1
+    *R(GICR_IGROUPR0) = 0xffffffff;
+
+    uint64 sre;
+    asm volatile("mrs %0, icc_sre_el1" : "=r" (sre));
+    asm volatile("msr icc_sre_el1, %0; isb" : : "r" (sre | 1));
+    // 不屏蔽任何优先级
+    asm volatile("msr icc_pmr_el1, %0" : : "r" ((uint64)0xff));
+    asm volatile("msr icc_bpr1_el1, %0" : : "r" ((uint64)0));
+    asm volatile("msr icc_igrpen1_el1, %0; isb" : : "r" ((uint64)1));
+}
+
+// 启用一个中断：SGI/PPI 在重分发器，SPI 在分发器
+void gic_enable_irq(uint32 irq) {
+    if(irq < 32) {
+        ((volatile uint8 *)R(GICR_IPRIORITYR))[irq] = GIC_DEFAULT_PRIO;
+        *R(GICR_ISENABLER0) = 1 << irq;
+        return;
+    }
+    *D(GICD_IGROUPR + (irq / 32) * 4) |= 1 << (irq % 32);
+    ((volatile uint8 *)D(GICD_IPRIORITYR))[irq] = GIC_DEFAULT_PRIO;
+    // 路由到 0 号核心
+    *(volatile uint64 *)D(GICD_IROUTER + irq * 8) = 0;
+    *D(GICD_ISENABLER + (irq / 32) * 4) = 1 << (irq % 32);
+    gicd_wait_rwp();
+}
+
+// 取得待处理中断号
+uint32 gic_claim(void) {
+    uint64 irq;
+    asm volatile("mrs %0, icc_iar1_el1" : "=r" (irq));
+    asm volatile("dsb sy" ::: "memory");
+    return irq & 0xffffff;
+}
+
+// 通知中断处理完毕
+void gic_complete(uint32 irq) {
+    asm volatile("msr icc_eoir1_el1, %0; isb" : : "r" ((uint64)irq));
+}
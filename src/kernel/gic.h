@@ -0,0 +1,16 @@
+#ifndef _GIC_H
+#define _GIC_H
+
+#include "types.h"
+
+// 特殊中断号：无待处理中断
+#define GIC_SPURIOUS 1020
+
+// 函数声明
+void gic_init(void);
+void gic_init_cpu(void);
+void gic_enable_irq(uint32 irq);
+uint32 gic_claim(void);
+void gic_complete(uint32 irq);
+
+#endif
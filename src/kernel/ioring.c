@@ -0,0 +1,354 @@
+#include "ioring.h"
+#include "blk.h"
+#include "fat.h"
+#include "memlayout.h"
+#include "mm.h"
+#include "pagecache.h"
+#include "proc.h"
+#include "vm.h"
+#include "wait.h"
+
+// 内核一侧的状态。打开时展开文件的簇链，之后扇区对齐、不跨页的读和不改变文件大小的写
+// 直接按扇区号交给块层：用户页在 I/O 期间多持有一个引用，每个扇区一个 blk_req，由块层合并成一个请求，
+// 最后一个扇区完成时在中断里写 CQE。其余读写（包括数据已在页缓存中的读）走 fat_read_file/fat_write_file，提交时就完成
+#define IO_NFILES     4
+#define IO_MAXCLUST   128                  // 每个文件展开的簇数上限，更远的数据走同步路径
+#define IO_INFLIGHT   16                   // 同时在途的异步操作数
+#define IO_OP_SECTORS (PAGE_SIZE / 512)    // 一个异步操作最多的扇区数
+
+struct io_file {
+    int used;
+    char name[11];
+    uint32 size;
+    uint32 spc;                   // 每簇扇区数
+    int nclust;
+    uint32 clust[IO_MAXCLUST];    // 各簇的起始扇区
+};
+
+struct io_ctx;
+
+struct io_op {
+    int used;
+    int pending;                  // 尚未完成的扇区请求数
+    int err;
+    int64 res;
+    uint64 user_data;
+    uint8 *page;                  // 持有引用的用户页，FLUSH 为 0
+    struct io_ctx *ctx;
+    struct blk_req req[IO_OP_SECTORS];
+};
+
+struct io_ctx {
+    struct io_rings *rings;       // 共享页的内核地址
+    int inflight;                 // 在途的异步操作数
+    uint64 completed;             // 已写出的 CQE 总数
+    struct wait_queue wq;         // 在 io_enter 中等完成的进程
+    struct io_file files[IO_NFILES];
+    struct io_op ops[IO_INFLIGHT];
+};
+
+#define IO_CTX_PAGES ((sizeof(struct io_ctx) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+// 写一个 CQE 并唤醒等待者，进程上下文和中断处理都会调用
+static void cq_post(struct io_ctx *c, uint64 user_data, int64 res) {
+    struct io_rings *r = c->rings;
+    push_off();
+    struct io_cqe *e = &r->cqes[r->cq_tail % IORING_ENTRIES];
+    e->user_data = user_data;
+    e->res = res;
+    // 先写 CQE 再推进 cq_tail
+    asm volatile("dmb ish" ::: "memory");
+    r->cq_tail++;
+    c->completed++;
+    wake_all(&c->wq);
+    pop_off();
+}
+
+// 扇区请求完成，在中断处理中调用
+static void io_req_done(struct blk_req *r) {
+    struct io_op *op = r->priv;
+    if(r->status != 0)
+        op->err = 1;
+    if(--op->pending > 0)
+        return;
+    struct io_ctx *c = op->ctx;
+    if(op->page)
+        page_put(op->page);
+    int64 res = op->err ? -1 : op->res;
+    uint64 user_data = op->user_data;
+    op->used = 0;
+    c->inflight--;
+    cq_post(c, user_data, res);
+}
+
+// 取一个空闲的操作并计入在途，io_submit 保证在途数不超过 IO_INFLIGHT，总能取到
+static struct io_op *io_op_start(struct io_ctx *c, struct io_sqe *e, uint8 *page, int64 res, int pending) {
+    struct io_op *op = 0;
+    push_off();
+    for(int i = 0; i < IO_INFLIGHT; i++) {
+        if(!c->ops[i].used) {
+            op = &c->ops[i];
+            break;
+        }
+    }
+    if(op) {
+        op->used = 1;
+        op->pending = pending;
+        op->err = 0;
+        op->res = res;
+        op->user_data = e->user_data;
+        op->page = page;
+        op->ctx = c;
+        c->inflight++;
+    }
+    pop_off();
+    return op;
+}
+
+static int io_file_load(struct io_file *f) {
+    f->nclust = fat_file_map(f->name, f->clust, IO_MAXCLUST, &f->size, &f->spc);
+    return f->nclust < 0 ? -1 : 0;
+}
+
+static int64 io_open(struct proc *p, struct io_ctx *c, struct io_sqe *e) {
+    char name[11];
+    if(copyin(p, name, e->addr, sizeof(name)) < 0)
+        return -1;
+    for(int fd = 0; fd < IO_NFILES; fd++) {
+        struct io_file *f = &c->files[fd];
+        if(f->used)
+            continue;
+        if(fat_file_size(name) < 0 && (!(e->flags & IO_CREATE) || fat_write_file(name, name, 0, 0) < 0))
+            return -1;
+        memcpy(f->name, name, sizeof(name));
+        if(io_file_load(f) < 0)
+            return -1;
+        f->used = 1;
+        return fd;
+    }
+    return -1;
+}
+
+// 尝试异步读写：已发出返回 1，不满足条件需要走同步路径返回 0，用户地址无效返回 -1
+static int io_async_rw(struct proc *p, struct io_ctx *c, struct io_sqe *e, struct io_file *f) {
+    int write = e->op == IO_WRITE;
+    uint64 cbytes = f->spc * 512;
+    if((e->off & 511) || (e->len & 511) || e->len == 0 ||
+       (e->addr & (PAGE_SIZE - 1)) + e->len > PAGE_SIZE || e->off >= f->size)
+        return 0;
+    uint64 n = e->len;
+    if(write) {
+        // 只改写已有的数据，文件变长要分配簇，走同步路径
+        if(e->off + n > f->size)
+            return 0;
+    } else if(n > f->size - e->off) {
+        n = f->size - e->off;
+    }
+    // 数据已在页缓存中（可能含映射写入、尚未写回的修改）时，读走同步路径从缓存拷贝
+    if(!write && (pcache_cached(f->name, e->off / PAGE_SIZE) || pcache_cached(f->name, (e->off + n - 1) / PAGE_SIZE)))
+        return 0;
+    uint32 nsect = (n + 511) / 512;
+    if((e->off + nsect * 512 - 1) / cbytes >= (uint64)f->nclust)
+        return 0;
+    // 设备往用户页里写（读文件）时要求页可写，写时复制页先复制
+    uint8 *page = uvm_lookup(p, e->addr, !write);
+    if(!page)
+        return -1;
+    page_get(page);
+    struct io_op *op = io_op_start(c, e, page, n, nsect);
+    if(!op) {
+        page_put(page);
+        return -1;
+    }
+    uint8 *buf = page + (e->addr & (PAGE_SIZE - 1));
+    // 写直接交给设备，已缓存的页同时改成新数据
+    if(write)
+        pcache_update(f->name, buf, n, e->off);
+    for(uint32 i = 0; i < nsect; i++) {
+        uint64 off = e->off + i * 512;
+        struct blk_req *r = &op->req[i];
+        r->buf = (char *)buf + i * 512;
+        r->sector = f->clust[off / cbytes] + (off % cbytes) / 512;
+        r->nsect = 1;
+        r->op = write ? BLK_WRITE : BLK_READ;
+        r->done = io_req_done;
+        r->priv = op;
+        blk_submit(fat_device(), r);
+    }
+    return 1;
+}
+
+// 同步读写：经内核页中转，按页调用 fat_read_file/fat_write_file。
+// 从文件开头写时文件大小以本次写入为准，与 fat_write_file 相同
+static int64 io_sync_rw(struct proc *p, struct io_sqe *e, struct io_file *f) {
+    uint64 len = e->len;
+    if(e->op == IO_READ) {
+        if(e->off >= f->size)
+            return 0;
+        if(len > f->size - e->off)
+            len = f->size - e->off;
+    }
+    uint8 *buf = alloc_pages(1);
+    if(!buf)
+        return -1;
+    int64 done = 0;
+    while(done < len) {
+        uint32 n = len - done > PAGE_SIZE ? PAGE_SIZE : len - done;
+        int r;
+        if(e->op == IO_READ) {
+            r = fat_read_file(f->name, buf, n, e->off + done);
+            if(r > 0 && copyout(p, e->addr + done, buf, r) < 0)
+                r = -1;
+        } else {
+            r = copyin(p, buf, e->addr + done, n) < 0 ? -1 : fat_write_file(f->name, buf, n, e->off + done);
+        }
+        if(r < 0) {
+            done = -1;
+            break;
+        }
+        done += r;
+        if(r < n)
+            break;
+    }
+    free_pages(buf, 1);
+    // 文件可能变长，重新展开簇链
+    if(e->op == IO_WRITE && io_file_load(f) < 0)
+        f->used = 0;
+    return done;
+}
+
+// 执行一个 SQE。异步操作的 CQE 在完成时写，其余的在这里写
+static void io_dispatch(struct proc *p, struct io_ctx *c, struct io_sqe *e) {
+    struct io_file *f = e->fd < IO_NFILES && c->files[e->fd].used ? &c->files[e->fd] : 0;
+    int64 res = -1;
+    switch(e->op) {
+    case IO_NOP:
+        res = 0;
+        break;
+    case IO_OPEN:
+        res = io_open(p, c, e);
+        break;
+    case IO_CLOSE:
+        if(f) {
+            f->used = 0;
+            res = 0;
+        }
+        break;
+    case IO_READ:
+    case IO_WRITE:
+        if(!f)
+            break;
+        int r = io_async_rw(p, c, e, f);
+        if(r > 0)
+            return;
+        if(r == 0)
+            res = io_sync_rw(p, e, f);
+        break;
+    case IO_FSYNC:
+        if(pcache_sync() < 0)
+            break;
+        // 脏页已写回，接着刷新设备写缓存
+    case IO_FLUSH: {
+        struct io_op *op = io_op_start(c, e, 0, 0, 1);
+        if(!op)
+            break;
+        op->req[0].op = BLK_FLUSH;
+        op->req[0].done = io_req_done;
+        op->req[0].priv = op;
+        blk_submit(fat_device(), &op->req[0]);
+        return;
+    }
+    }
+    cq_post(c, e->user_data, res);
+}
+
+// 从 SQ 取最多 max 个 SQE 执行，返回取走的个数。CQ 的空位不够容纳已在途的操作再加一个，
+// 或者遇到屏障而仍有在途操作时停下。一批操作的扇区请求在块层攒齐后一起发出
+static uint32 io_submit(struct proc *p, struct io_ctx *c, uint32 max) {
+    struct io_rings *r = c->rings;
+    struct blk_dev *d = fat_device();
+    uint32 n = 0;
+    if(d)
+        blk_plug(d);
+    while(n < max && r->sq_head != r->sq_tail) {
+        uint32 cq_used = r->cq_tail - r->cq_head;
+        if(cq_used > IORING_ENTRIES || cq_used + c->inflight >= IORING_ENTRIES || c->inflight >= IO_INFLIGHT)
+            break;
+        // 看到 sq_tail 之后再读 SQE；先拷贝出来，用户之后再改也不影响
+        asm volatile("dmb ish" ::: "memory");
+        struct io_sqe e = r->sqes[r->sq_head % IORING_ENTRIES];
+        if((e.op == IO_FSYNC || e.op == IO_FLUSH) && c->inflight)
+            break;
+        r->sq_head++;
+        n++;
+        io_dispatch(p, c, &e);
+    }
+    if(d)
+        blk_unplug(d);
+    return n;
+}
+
+// 建立 p 的 I/O 环并映射到 IORING_BASE，返回该地址，失败返回 0。
+// 环页标成共享页，fork 后父进程写 sq_tail 不会触发写时复制而与内核看到的页分开
+uint64 ioring_setup(struct proc *p) {
+    if(p->io)
+        return IORING_BASE;
+    if(!p->pagetable)
+        return 0;
+    // fork 继承来的映射仍是父进程的环，子进程不能再建
+    uint64 *pte = walk(p->pagetable, IORING_BASE, 0);
+    if(pte && (*pte & PTE_VALID))
+        return 0;
+    struct io_ctx *c = alloc_pages_flags(IO_CTX_PAGES, ALLOC_ZERO);
+    if(!c)
+        return 0;
+    c->rings = alloc_pages_flags(1, ALLOC_ZERO);
+    if(!c->rings) {
+        free_pages(c, IO_CTX_PAGES);
+        return 0;
+    }
+    page_get(c->rings);
+    if(uvm_map(p->pagetable, IORING_BASE, PAGE_SIZE, V2P(c->rings), UVM_RW | PTE_SHARED) < 0) {
+        page_put(c->rings);
+        page_put(c->rings);
+        free_pages(c, IO_CTX_PAGES);
+        return 0;
+    }
+    wait_queue_init(&c->wq);
+    p->io = c;
+    return IORING_BASE;
+}
+
+// 提交最多 to_submit 个 SQE，再等到 CQ 中至少有 min_complete 个未收取的 CQE，返回提交的个数。
+// 没有在途操作时不再等待：提交被 CQ 空位挡住，要用户先收取
+int ioring_enter(struct proc *p, uint32 to_submit, uint32 min_complete) {
+    struct io_ctx *c = p->io;
+    if(!c)
+        return -1;
+    struct io_rings *r = c->rings;
+    if(min_complete > IORING_ENTRIES)
+        min_complete = IORING_ENTRIES;
+    uint32 submitted = 0;
+    for(;;) {
+        submitted += io_submit(p, c, to_submit - submitted);
+        uint64 seen = c->completed;
+        int more = submitted < to_submit && r->sq_head != r->sq_tail;
+        if(!more && r->cq_tail - r->cq_head >= min_complete)
+            break;
+        if(c->inflight == 0)
+            break;
+        wait_event(&c->wq, c->completed != seen);
+    }
+    return submitted;
+}
+
+// 进程退出：等在途操作完成（设备还会写用户页和 CQE），再释放环和内核状态
+void ioring_exit(struct proc *p) {
+    struct io_ctx *c = p->io;
+    if(!c)
+        return;
+    wait_event(&c->wq, c->inflight == 0);
+    p->io = 0;
+    page_put(c->rings);
+    free_pages(c, IO_CTX_PAGES);
+}
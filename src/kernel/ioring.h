@@ -0,0 +1,63 @@
+#ifndef _IORING_H
+#define _IORING_H
+
+#include "types.h"
+
+// 异步 I/O 环：每个进程一页共享内存，里面是提交队列（SQ）和完成队列（CQ）。
+// 用户填好 SQE 推进 sq_tail，再用一次 io_enter 让内核成批取走；内核把对齐的读写拆成扇区请求
+// 交给块层，设备完成时在中断里直接写 CQE，不为每个操作切换进程。用户程序（src/user）也包含这个头文件
+#define IORING_ENTRIES 64                  // SQ 和 CQ 的条目数，2 的幂
+#define IORING_BASE    0x1f000000UL        // 环在用户地址空间中的位置
+
+// 操作码
+#define IO_NOP   0
+#define IO_OPEN  1   // addr 指向 11 字节的 8.3 文件名，flags 可带 IO_CREATE，结果是 fd
+#define IO_CLOSE 2
+#define IO_READ  3   // 从 fd 的 off 处读 len 字节到 addr，结果是读到的字节数
+#define IO_WRITE 4   // 把 addr 处的 len 字节写到 fd 的 off 处，结果是写出的字节数
+#define IO_FSYNC 5   // 写回页缓存中的脏页并刷新设备写缓存
+#define IO_FLUSH 6   // 只刷新设备写缓存
+
+// IO_OPEN 的 flags
+#define IO_CREATE 1  // 文件不存在时新建
+
+// FSYNC 和 FLUSH 是屏障：之前提交的操作全部完成后才开始，完成之前也不取后面的 SQE
+
+struct io_sqe {
+    uint8 op;
+    uint8 flags;
+    uint16 fd;
+    uint32 len;
+    uint64 off;
+    uint64 addr;
+    uint64 user_data;             // 原样带回 CQE
+};
+
+struct io_cqe {
+    uint64 user_data;
+    int64 res;                    // 出错时为 -1
+};
+
+// 序号只增不减。用户写 sq_tail 和 cq_head，内核写 sq_head 和 cq_tail，各占一个缓存行。
+// 内核只在 CQ 的空位足够容纳全部在途操作时才取 SQE，CQ 不会溢出
+struct io_rings {
+    volatile uint32 sq_head;
+    uint8 pad0[60];
+    volatile uint32 sq_tail;
+    uint8 pad1[60];
+    volatile uint32 cq_head;
+    uint8 pad2[60];
+    volatile uint32 cq_tail;
+    uint8 pad3[60];
+    struct io_sqe sqes[IORING_ENTRIES];
+    struct io_cqe cqes[IORING_ENTRIES];
+};
+
+struct proc;
+
+// 函数声明
+uint64 ioring_setup(struct proc *p);
+int ioring_enter(struct proc *p, uint32 to_submit, uint32 min_complete);
+void ioring_exit(struct proc *p);
+
+#endif
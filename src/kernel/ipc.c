@@ -0,0 +1,272 @@
+#include "ipc.h"
+#include "mm.h"
+#include "memlayout.h"
+#include "proc.h"
+#include "trap.h"
+#include "vm.h"
+#include "wait.h"
+
+// 内核一侧的通道状态。共享页的每一页由通道持有一个引用，每个映射再各持有一个，
+// 关闭通道后仍映射着它的进程可以继续访问，直到退出。
+// 整页转移先由发送方 ipc_give 把页从自己的地址空间摘下挂到通道上，再在环中放一条
+// 带 IPC_MSG_PAGES 的消息；接收方读到这条消息后 ipc_take 把页映射到自己的缓冲区，
+// 之后才推进 head。因此待收取的转移与环中的消息一一对应，不会超过 IPC_SLOTS 个
+
+struct ipc_xfer {
+    uint32 len;
+    uint32 npages;
+    uint8 *page[IPC_XFER_PAGES];
+};
+
+#define XFER_PAGES ((IPC_SLOTS * sizeof(struct ipc_xfer) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+struct chan {
+    int used;
+    struct ipc_shared *sh;        // 共享页的内核地址
+    struct wait_queue wq[2];      // 在各环上等消息或等空槽的进程
+    struct ipc_xfer *xq[2];       // 各环待收取的整页转移
+    uint32 xhead[2], xtail[2];
+};
+
+static struct chan chans[NCHAN];
+
+static struct chan *chan_get(int id) {
+    if(id < 0 || id >= NCHAN || !chans[id].used)
+        return 0;
+    return &chans[id];
+}
+
+// 新建通道，返回 id，没有空闲通道或内存不足时返回 -1
+int chan_create(void) {
+    for(int id = 0; id < NCHAN; id++) {
+        struct chan *c = &chans[id];
+        if(c->used)
+            continue;
+        c->sh = alloc_pages_flags(IPC_PAGES, ALLOC_ZERO);
+        c->xq[0] = alloc_pages(XFER_PAGES * 2);
+        if(!c->sh || !c->xq[0]) {
+            if(c->sh)
+                free_pages(c->sh, IPC_PAGES);
+            if(c->xq[0])
+                free_pages(c->xq[0], XFER_PAGES * 2);
+            return -1;
+        }
+        c->xq[1] = (struct ipc_xfer *)((uint8 *)c->xq[0] + XFER_PAGES * PAGE_SIZE);
+        for(int r = 0; r < 2; r++) {
+            wait_queue_init(&c->wq[r]);
+            c->xhead[r] = c->xtail[r] = 0;
+        }
+        c->used = 1;
+        return id;
+    }
+    return -1;
+}
+
+// 关闭通道：释放未收取的转移页，放弃通道对共享页的引用，唤醒所有等待者
+int chan_close(int id) {
+    struct chan *c = chan_get(id);
+    if(!c)
+        return -1;
+    c->used = 0;
+    for(int r = 0; r < 2; r++) {
+        for(; c->xhead[r] != c->xtail[r]; c->xhead[r]++) {
+            struct ipc_xfer *x = &c->xq[r][c->xhead[r] % IPC_SLOTS];
+            for(uint32 i = 0; i < x->npages; i++)
+                page_put(x->page[i]);
+        }
+        wake_all(&c->wq[r]);
+    }
+    for(uint64 i = 0; i < IPC_PAGES; i++)
+        page_put((uint8 *)c->sh + i * PAGE_SIZE);
+    free_pages(c->xq[0], XFER_PAGES * 2);
+    c->sh = 0;
+    return 0;
+}
+
+// 把通道的共享页映射进 p，返回用户地址；已经映射过（例如 fork 继承）时直接返回。
+// 同一 id 的旧通道关闭后留下的映射指向旧的共享页，换成当前通道的
+uint64 chan_map(struct proc *p, int id) {
+    struct chan *c = chan_get(id);
+    if(!c)
+        return 0;
+    uint64 va = IPC_BASE + id * IPC_MAP_SIZE;
+    uint64 *pte = walk(p->pagetable, va, 0);
+    if(pte && (*pte & PTE_VALID)) {
+        if(PTE_ADDR(*pte) == V2P(c->sh))
+            return va;
+        uvm_unmap(p, va, IPC_PAGES);
+    }
+    for(uint64 i = 0; i < IPC_PAGES; i++) {
+        uint8 *page = (uint8 *)c->sh + i * PAGE_SIZE;
+        page_get(page);
+        // 标成共享页，fork 时父子进程继续共享而不是写时复制
+        if(uvm_map(p->pagetable, va + i * PAGE_SIZE, PAGE_SIZE, V2P(page), UVM_RW | PTE_SHARED) < 0) {
+            // 撤销已经映射的页，不留下只映射了一部分的通道
+            page_put(page);
+            uvm_unmap(p, va, i);
+            return 0;
+        }
+    }
+    return va;
+}
+
+// 睡眠直到环 ring 中有消息（IPC_WAIT_DATA）或有空槽（IPC_WAIT_SPACE），通道关闭时返回 -1。
+// 条件在内核里关中断检查，用户先置 want_* 再检查环、对方先推进序号再看 want_*，
+// 两边都有屏障，不会错过门铃
+int chan_wait(int id, int ring, int what) {
+    struct chan *c = chan_get(id);
+    if(!c || ring < 0 || ring > 1)
+        return -1;
+    struct ipc_ctl *ctl = &c->sh->ctl[ring];
+    if(what == IPC_WAIT_DATA)
+        wait_event(&c->wq[ring], !c->used || ctl->tail != ctl->head);
+    else
+        wait_event(&c->wq[ring], !c->used || ctl->tail - ctl->head < IPC_SLOTS);
+    return c->used ? 0 : -1;
+}
+
+// 门铃：唤醒在环 ring 上等待的进程
+int chan_notify(int id, int ring) {
+    struct chan *c = chan_get(id);
+    if(!c || ring < 0 || ring > 1)
+        return -1;
+    wake_all(&c->wq[ring]);
+    return 0;
+}
+
+// 把 p 的缓冲区 [va, va + len) 中的页摘下挂到环 ring 上，等待对方 ipc_take。
+// 页的所有权随之转移，之后再访问这段地址会得到新的清零页
+int chan_give(struct proc *p, int id, int ring, uint64 va, uint64 len) {
+    struct chan *c = chan_get(id);
+    uint64 npages = PGROUNDUP(len) / PAGE_SIZE;
+    if(!c || ring < 0 || ring > 1 || (va & (PAGE_SIZE - 1)) || npages == 0 ||
+       npages > IPC_XFER_PAGES || va < IPC_BUF_BASE || va + len > IPC_BUF_END)
+        return -1;
+    if(c->xtail[ring] - c->xhead[ring] >= IPC_SLOTS)
+        return -1;
+    struct ipc_xfer *x = &c->xq[ring][c->xtail[ring] % IPC_SLOTS];
+    x->len = len;
+    for(x->npages = 0; x->npages < npages; x->npages++) {
+        uint8 *page = uvm_unmap_page(p, va + x->npages * PAGE_SIZE);
+        if(!page) {
+            // 已摘下的页放回原处
+            while(x->npages-- > 0)
+                uvm_replace_page(p, va + x->npages * PAGE_SIZE, x->page[x->npages]);
+            return -1;
+        }
+        x->page[x->npages] = page;
+    }
+    c->xtail[ring]++;
+    return 0;
+}
+
+// 把环 ring 上最早的一次转移映射到 p 的缓冲区 va 处，替换原来映射在那里的页，返回字节数
+int chan_take(struct proc *p, int id, int ring, uint64 va) {
+    struct chan *c = chan_get(id);
+    if(!c || ring < 0 || ring > 1 || (va & (PAGE_SIZE - 1)) || c->xhead[ring] == c->xtail[ring])
+        return -1;
+    struct ipc_xfer *x = &c->xq[ring][c->xhead[ring] % IPC_SLOTS];
+    if(va < IPC_BUF_BASE || va + x->npages * PAGE_SIZE > IPC_BUF_END)
+        return -1;
+    for(uint32 i = 0; i < x->npages; i++) {
+        if(uvm_replace_page(p, va + i * PAGE_SIZE, x->page[i]) < 0) {
+            // 没映射上的页随转移一起丢弃
+            for(; i < x->npages; i++)
+                page_put(x->page[i]);
+            c->xhead[ring]++;
+            return -1;
+        }
+    }
+    c->xhead[ring]++;
+    return x->len;
+}
+
+// 同步调用端点。服务进程在 reply_wait 中阻塞时挂在 server 上，客户 call 时直接切换过去，
+// 不经过就绪队列；服务进程忙时客户在 callers 上排队，服务进程下次 reply_wait 时直接取走。
+// 消息是陷阱帧中的 x2-x5，x1 留给用户桩存放消息结构的地址
+struct endpoint {
+    int used;
+    struct proc *server;          // 在 reply_wait 中等待调用的服务进程
+    struct wait_queue callers;    // 服务进程忙时排队的客户
+};
+
+static struct endpoint eps[NEP];
+
+static void msg_copy(struct trapframe *dst, struct trapframe *src) {
+    for(int i = 0; i < IPC_MSG_WORDS; i++)
+        dst->x[2 + i] = src->x[2 + i];
+}
+
+// 新建端点，返回 id，没有空闲端点时返回 -1
+int ep_create(void) {
+    for(int id = 0; id < NEP; id++) {
+        if(eps[id].used)
+            continue;
+        eps[id].used = 1;
+        eps[id].server = 0;
+        wait_queue_init(&eps[id].callers);
+        return id;
+    }
+    return -1;
+}
+
+// 客户调用：把消息交给服务进程并等待回复，回复放回 p 的陷阱帧。成功返回 0，
+// 服务进程没有回复就退出时返回 -1
+int ep_call(struct proc *p, int id) {
+    if(id < 0 || id >= NEP || !eps[id].used)
+        return -1;
+    struct endpoint *ep = &eps[id];
+    push_off();
+    p->ipc_status = -1;
+    struct proc *server = ep->server;
+    if(server) {
+        // 快速路径：服务进程已在等待，消息直接写进它的陷阱帧，CPU 连同剩余时间片交给它
+        ep->server = 0;
+        msg_copy(server->tf, p->tf);
+        server->ipc_caller = p;
+        p->state = BLOCKED;
+        proc_handoff(server);
+    } else {
+        // 服务进程忙：排队，由它下次 reply_wait 时取走消息
+        wait_sleep(&ep->callers);
+    }
+    pop_off();
+    return p->ipc_status;
+}
+
+// 服务进程回复上一个调用者（如果有），再等待下一次调用，返回调用者的 pid，消息在 p 的陷阱帧里。
+// 没有排队的客户时直接切回刚回复的调用者，一次往返只有两次进程间切换
+int ep_reply_wait(struct proc *p, int id) {
+    if(id < 0 || id >= NEP || !eps[id].used)
+        return -1;
+    struct endpoint *ep = &eps[id];
+    push_off();
+    if(ep->server) {
+        // 每个端点只允许一个服务进程等待
+        pop_off();
+        return -1;
+    }
+    struct proc *caller = p->ipc_caller;
+    if(caller) {
+        msg_copy(caller->tf, p->tf);
+        caller->ipc_status = 0;
+        p->ipc_caller = 0;
+    }
+    struct proc *next = wait_dequeue(&ep->callers);
+    if(next) {
+        // 已有客户在排队：取走它的消息直接返回，刚回复的调用者按普通唤醒进入就绪队列
+        msg_copy(p->tf, next->tf);
+        p->ipc_caller = next;
+        if(caller)
+            proc_ready(caller);
+    } else {
+        ep->server = p;
+        p->state = BLOCKED;
+        if(caller)
+            proc_handoff(caller);
+        else
+            sched();
+    }
+    pop_off();
+    return p->ipc_caller ? (int)p->ipc_caller->pid : -1;
+}
@@ -0,0 +1,78 @@
+#ifndef _IPC_H
+#define _IPC_H
+
+#include "types.h"
+
+// 进程间通信通道：两个单生产者/单消费者消息环放在双方共享的页中，收发消息不进内核。
+// 内核只负责建立共享映射、睡眠等待与门铃唤醒，以及整页转移。
+// 环 0 和环 1 各管一个方向，由使用双方约定。用户程序（src/user）也包含这个头文件
+#define NCHAN          8
+#define IPC_SLOTS      64                    // 每个环的消息槽数，2 的幂
+#define IPC_SLOT_SIZE  128
+#define IPC_MSG_MAX    (IPC_SLOT_SIZE - 8)   // 内联消息的最大长度
+#define IPC_XFER_PAGES 16                    // 一次最多转移的页数（64KB）
+
+// 用户地址空间：通道 id 的共享页映射在 IPC_BASE + id * IPC_MAP_SIZE；
+// [IPC_BUF_BASE, IPC_BUF_END) 是缺页时分配清零页的缓冲区，只有这里的页可以转移
+#define IPC_BASE      0x20000000UL
+#define IPC_MAP_SIZE  0x10000UL
+#define IPC_BUF_BASE  0x30000000UL
+#define IPC_BUF_END   0x40000000UL
+
+// 消息标志
+#define IPC_MSG_PAGES 1   // 内容不在槽里，由接收方 ipc_take 把页映射过来，len 为字节数
+
+// ipc_wait 等待的条件
+#define IPC_WAIT_DATA  0  // 环中有消息
+#define IPC_WAIT_SPACE 1  // 环中有空槽
+
+// 同步调用：客户 call 把 IPC_MSG_WORDS 个字的消息放在寄存器里交给端点上等待的服务进程，
+// 直接切换过去；服务进程 reply_wait 回复后同样直接切回客户
+#define NEP 8
+#define IPC_MSG_WORDS 4
+
+struct ipc_msg {
+    uint64 w[IPC_MSG_WORDS];
+};
+
+struct ipc_slot {
+    uint32 len;
+    uint32 flags;
+    uint8 data[IPC_MSG_MAX];
+};
+
+// 一个环的控制字段。序号只增不减，tail - head 是环中的消息数；
+// 生产者和消费者各自写的字段分在不同缓存行
+struct ipc_ctl {
+    volatile uint32 tail;         // 生产者写：下一条消息的序号
+    volatile uint32 want_space;   // 生产者写：环满，正在等空槽
+    uint8 pad0[56];
+    volatile uint32 head;         // 消费者写：下一条待读消息的序号
+    volatile uint32 want_data;    // 消费者写：环空，正在等消息
+    uint8 pad1[56];
+};
+
+// 共享区布局：第 0 页是两个环的控制字段，之后是各环的消息槽
+struct ipc_shared {
+    struct ipc_ctl ctl[2];
+    uint8 pad[4096 - 2 * sizeof(struct ipc_ctl)];
+    struct ipc_slot slot[2][IPC_SLOTS];
+};
+
+#define IPC_PAGES (sizeof(struct ipc_shared) / 4096)
+
+struct proc;
+
+// 函数声明
+int chan_create(void);
+int chan_close(int id);
+uint64 chan_map(struct proc *p, int id);
+int chan_wait(int id, int ring, int what);
+int chan_notify(int id, int ring);
+int chan_give(struct proc *p, int id, int ring, uint64 va, uint64 len);
+int chan_take(struct proc *p, int id, int ring, uint64 va);
+int ep_create(void);
+int ep_call(struct proc *p, int id);
+int ep_reply_wait(struct proc *p, int id);
+
+#endif
@@ -1,8 +1,21 @@
+#include "aarch64.h"
 #include "uart.h"
+#include "trap.h"
+#include "gic.h"
+#include "printk.h"
 #include "proc.h"
 #include "mm.h"
+#include "ipc.h"
+#include "pagecache.h"
+#include "vm.h"
 #include "virtio_blk.h"
+#include "blk.h"
 #include "fat.h"
+#include "timer.h"
+#include "trace.h"
+#include "bench.h"
+#include "bootprof.h"
+#include "neon.h"
 
 // 测试进程函数
 void proc1_func(void) {
@@ -49,15 +62,9 @@ void proc3_func(void) {
 
 // 打印进程上下文信息
 static void print_context_info(struct context *ctx, const char *name) {
-    uart_puts("\n上下文信息：");
-    uart_puts(name);
-    uart_puts(":\n");
-    uart_puts("x30（返回地址） = 0x");
-    uart_put_hex(ctx->x30);
-    uart_puts("\n");
-    uart_puts("sp = 0x");
-    uart_put_hex(ctx->sp);
-    uart_puts("\n");
+    pr_info("\n上下文信息：%s:\n", name);
+    pr_info("x30（返回地址） = 0x%016lx\n", ctx->x30);
+    pr_info("sp = 0x%016lx\n", ctx->sp);
 }
 
 // 初始化进程栈和上下文
@@ -68,11 +75,11 @@ void init_proc_stack(struct proc *p, void (*func)(void), void *stack, uint32 sta
     
     // 设置上下文
     p->context.sp = (uint64)stack_top;  // 栈指针指向栈顶
-    p->context.x30 = (uint64)func;      // 链接寄存器指向进程函数
+    p->context.x30 = (uint64)proc_trampoline; // 首次调度时先经过入口跳板
     
     // 初始化其他寄存器
     p->context.x18 = 0;  // 平台寄存器
-    p->context.x19 = 0;
+    p->context.x19 = (uint64)func;      // 跳板从 x19 取进程函数
     p->context.x20 = 0;
     p->context.x21 = 0;
     p->context.x22 = 0;
@@ -85,24 +92,16 @@ void init_proc_stack(struct proc *p, void (*func)(void), void *stack, uint32 sta
     p->context.x29 = 0;  // 帧指针
 
     // 打印初始化信息
-    uart_puts("\n正在初始化进程 ");
-    uart_putc('0' + p->pid);
-    uart_puts("\n");
-    uart_puts("栈基址 = 0x");
-    uart_put_hex((uint64)stack);
-    uart_puts("\n");
-    uart_puts("栈顶 = 0x");
-    uart_put_hex((uint64)stack_top);
-    uart_puts("\n");
-    uart_puts("函数地址 = 0x");
-    uart_put_hex((uint64)func);
-    uart_puts("\n");
+    pr_info("\n正在初始化进程 %lu\n", p->pid);
+    pr_info("栈基址 = %p\n", stack);
+    pr_info("栈顶 = %p\n", stack_top);
+    pr_info("函数地址 = %p\n", func);
     print_context_info(&p->context, "初始上下文");
 }
 
 // 测试 virtio-blk 驱动
 void test_virtio_blk(void) {
-    uart_puts("正在测试virtio块设备...\n");
+    pr_info("正在测试virtio块设备...\n");
 
     // 分配一个缓冲区用于测试
     char test_buf[512];
@@ -112,22 +111,22 @@ void test_virtio_blk(void) {
         test_buf[i] = i & 0xFF;
     }
 
-    uart_puts("正在写入测试数据到扇区0...\n");
+    pr_info("正在写入测试数据到扇区0...\n");
 
     // 尝试写入扇区 0
     if(virtio_blk_rw(test_buf, 0, 1) == 0) {
-        uart_puts("写入成功\n");
+        pr_info("写入成功\n");
 
         // 清空缓冲区
         for(int i = 0; i < 512; i++) {
             test_buf[i] = 0;
         }
 
-        uart_puts("正在从扇区0读取...\n");
+        pr_info("正在从扇区0读取...\n");
 
         // 尝试读取扇区 0
         if(virtio_blk_rw(test_buf, 0, 0) == 0) {
-            uart_puts("读取成功\n");
+            pr_info("读取成功\n");
 
             // 验证数据
             int correct = 1;
@@ -139,20 +138,20 @@ void test_virtio_blk(void) {
             }
 
             if(correct) {
-                uart_puts("数据校验成功！\n");
+                pr_info("数据校验成功！\n");
             } else {
-                uart_puts("数据校验失败！\n");
+                pr_err("数据校验失败！\n");
             }
         } else {
-            uart_puts("读取失败\n");
+            pr_err("读取失败\n");
         }
     } else {
-        uart_puts("写入失败\n");
+        pr_err("写入失败\n");
     }
 }
 
 void test_fat(void) {
-    uart_puts("\nFAT 文件系统测试开始\n");
+    pr_info("\nFAT 文件系统测试开始\n");
     // 1. 新建文件并写入内容
     const char *fn1 = "TEST1   TXT";
     const char *fn2 = "TEST2   TXT";
@@ -160,25 +159,25 @@ void test_fat(void) {
     char buf2[32] = "File 2, first content.";
     int w1 = fat_write_file(fn1, buf1, 23, 0);
     int w2 = fat_write_file(fn2, buf2, 22, 0);
-    uart_puts("新建并写入TEST1.TXT字节数: "); uart_put_hex(w1); uart_puts("\n");
-    uart_puts("新建并写入TEST2.TXT字节数: "); uart_put_hex(w2); uart_puts("\n");
+    pr_info("新建并写入TEST1.TXT字节数: %d\n", w1);
+    pr_info("新建并写入TEST2.TXT字节数: %d\n", w2);
     // 2. 覆盖写入同名文件
     char buf1b[32] = "Overwrite file 1!";
     int w1b = fat_write_file(fn1, buf1b, 18, 0);
-    uart_puts("覆盖写入TEST1.TXT字节数: "); uart_put_hex(w1b); uart_puts("\n");
+    pr_info("覆盖写入TEST1.TXT字节数: %d\n", w1b);
     // 3. 读取文件内容
     char rbuf[40];
     int r1 = fat_read_file(fn1, rbuf, 23, 0);
     rbuf[r1 > 0 ? r1 : 0] = 0;
-    uart_puts("读取TEST1.TXT内容: "); uart_puts(rbuf); uart_puts("\n");
+    pr_info("读取TEST1.TXT内容: %s\n", rbuf);
     int r2 = fat_read_file(fn2, rbuf, 22, 0);
     rbuf[r2 > 0 ? r2 : 0] = 0;
-    uart_puts("读取TEST2.TXT内容: "); uart_puts(rbuf); uart_puts("\n");
+    pr_info("读取TEST2.TXT内容: %s\n", rbuf);
     // 4. 读取不存在的文件
     int r3 = fat_read_file("NOFILE  TXT", rbuf, 20, 0);
-    uart_puts("读取NOFILE.TXT返回: "); uart_put_hex(r3); uart_puts(" (应为-1)\n");
+    pr_info("读取NOFILE.TXT返回: %d (应为-1)\n", r3);
     // 5. 遍历根目录
-    uart_puts("根目录文件列表:\n");
+    pr_info("根目录文件列表:\n");
     struct fat_dir_entry entries[16];
     int n = fat_list_dir("/", entries, 16);
     for (int i = 0; i < n; i++) {
@@ -189,13 +188,259 @@ void test_fat(void) {
         name[8] = '.';
         for (int j = 0; j < 3; j++) name[9 + j] = entries[i].name[8 + j];
         name[12] = 0;
-        uart_puts("  ");
-        uart_puts(name);
-        uart_puts(" size: ");
-        uart_put_hex(entries[i].size);
-        uart_puts("\n");
+        pr_info("  %s size: %u\n", name, entries[i].size);
+    }
+    // 6. 每次追加 512 字节，跨过多个簇边界，最后追加不足一个扇区；检查大小并整体读回
+    const int total = 20 * 512 + 100;
+    char *wbuf = alloc_pages(3), *rbig = alloc_pages(3);
+    if (wbuf && rbig) {
+        int ok = 1;
+        for (int i = 0; i < total; i++) wbuf[i] = 'a' + i % 23;
+        for (int off = 0; off < total; off += 512) {
+            int len = total - off < 512 ? total - off : 512;
+            if (fat_write_file("APPEND  TXT", wbuf + off, len, off) != len) ok = 0;
+        }
+        if (fat_file_size("APPEND  TXT") != total ||
+            fat_read_file("APPEND  TXT", rbig, total, 0) != total ||
+            memcmp(wbuf, rbig, total) != 0)
+            ok = 0;
+        pr_info("跨簇追加写入 %d 字节%s\n", total, ok ? "正确" : "错误");
+    }
+    if (wbuf) free_pages(wbuf, 3);
+    if (rbig) free_pages(rbig, 3);
+    pr_info("[TEST] FAT 文件系统测试结束\n\n");
+}
+
+// 对比轮询输出、缓冲区输出与 printk 在大量日志下占用的 CPU 时间
+void test_uart_log(void) {
+    const char *line = "uart log benchmark: 0123456789abcdefghijklmnopqrstuvwxyz\n";
+    const int lines = 32;
+
+    uint64 t0 = r_cntvct();
+    for(int i = 0; i < lines; i++)
+        uart_puts_sync(line);
+    uint64 t1 = r_cntvct();
+
+    // 进程上下文中中断已打开，发送中断在后台清空缓冲区
+    uint64 t2 = r_cntvct();
+    for(int i = 0; i < lines; i++)
+        uart_puts(line);
+    uint64 t3 = r_cntvct();
+    uart_flush();
+
+    // printk 只写内存，控制台输出推迟到空闲时
+    uint64 t4 = r_cntvct();
+    for(int i = 0; i < lines; i++)
+        pr_debug("%s", line);
+    uint64 t5 = r_cntvct();
+
+    uint64 freq = r_cntfrq();
+    pr_info("轮询输出耗时: %lu us\n", (t1 - t0) * 1000000 / freq);
+    pr_info("缓冲区输出耗时: %lu us\n", (t3 - t2) * 1000000 / freq);
+    pr_info("printk 耗时: %lu us\n", (t5 - t4) * 1000000 / freq);
+}
+
+// 每个进程把自己的 pid 写满向量寄存器，多次让出 CPU 后检查是否被别人覆盖
+static void fpsimd_worker(void) {
+    uint64 v = 0x0101010101010101UL * myproc()->pid;
+    int bad = 0;
+    fpsimd_fill(v);
+    for(int i = 0; i < 100; i++) {
+        yield();
+        bad += fpsimd_check(v);
     }
-    uart_puts("[TEST] FAT 文件系统测试结束\n\n");
+    if(bad)
+        pr_err("进程 %lu: FP/SIMD 状态被破坏 %d 次\n", myproc()->pid, bad);
+    else
+        pr_info("进程 %lu: FP/SIMD 状态保存正确\n", myproc()->pid);
+}
+
+void test_fpsimd(void) {
+    for(int i = 0; i < 2; i++) {
+        struct proc *p = kthread_create(fpsimd_worker);
+        if(!p) {
+            pr_err("进程分配失败！\n");
+            return;
+        }
+        proc_ready(p);
+    }
+}
+
+// 两个 EL0 进程，各自打印 pid 后退出
+void test_user(void) {
+    for(int i = 0; i < 2; i++) {
+        struct proc *p = user_create("hello", 0);
+        if(!p) {
+            pr_err("用户进程创建失败！\n");
+            return;
+        }
+        proc_ready(p);
+    }
+    // 栈按需增长到 64KB；超过 1MB 保留区的进程撞上保护页被结束
+    struct proc *deep = user_create("stack", 64);
+    struct proc *overflow = user_create("stack", 2048);
+    if(!deep || !overflow) {
+        pr_err("用户进程创建失败！\n");
+        return;
+    }
+    proc_ready(deep);
+    proc_ready(overflow);
+    // 写时复制 fork
+    struct proc *f = user_create("forktest", 0);
+    if(f)
+        proc_ready(f);
+}
+
+// 映射文件写入后 msync，再绕过页缓存读回检查
+void test_mmap(void) {
+    char buf[4096];
+    for(int i = 0; i < 4096; i++)
+        buf[i] = i;
+    int ok = 1;
+    for(int off = 0; off < 16384; off += 4096)
+        if(fat_write_file("MAPTEST BIN", buf, 4096, off) != 4096)
+            ok = 0;
+    struct proc *p = ok ? user_create("mapper", 1UL << 32 | 1) : 0;
+    if(!p) {
+        pr_err("mmap 测试文件创建失败\n");
+        return;
+    }
+    uint64 pid = p->pid;
+    proc_ready(p);
+    proc_wait(pid);
+    for(int off = 0; off < 16384; off += 4096) {
+        char c;
+        // 绕过页缓存读磁盘，检查确实写回了
+        if(fat_read_direct("MAPTEST BIN", &c, 1, off) != 1 || c != 1 ||
+           fat_read_file("MAPTEST BIN", &c, 1, off) != 1 || c != 1)
+            ok = 0;
+    }
+    struct pcache_stats st;
+    pcache_get_stats(&st);
+    pr_info("mmap 写回%s，页缓存命中 %lu，读入 %lu，写回 %lu\n",
+            ok ? "正确" : "错误", st.hits, st.misses, st.writebacks);
+}
+
+// 定时器：sleep_ms 至少睡够时间；在没人唤醒的队列上 wait_event_timeout 应当超时返回
+void test_timer(void) {
+    uint64 freq = r_cntfrq();
+    uint64 t0 = r_cntvct();
+    sleep_ms(10);
+    uint64 slept = r_cntvct() - t0;
+    struct wait_queue wq = WAIT_QUEUE_INIT;
+    int ret;
+    t0 = r_cntvct();
+    wait_event_timeout(&wq, 0, 5000000, ret);
+    uint64 waited = r_cntvct() - t0;
+    pr_info("sleep_ms(10) 实际 %lu us，等待超时%s（%lu us）\n", slept * 1000000 / freq,
+            ret < 0 && waited >= ns_to_ticks(5000000) ? "正确" : "错误", waited * 1000000 / freq);
+}
+
+// IPC 通道：内联消息和整页转移各收发一批，ipcpeer 逐条检查序号，出错时自己打印；
+// 再用 pingpong 做一批同步调用，服务进程晚于客户启动，先走排队的慢速路径
+void test_ipc(void) {
+    for(uint64 mode = 0; mode <= 1; mode++) {
+        int id = chan_create();
+        uint64 arg = (uint64)id | mode << 9 | 200UL << 32;
+        struct proc *rx = id < 0 ? 0 : user_create("ipcpeer", arg | 1UL << 8);
+        struct proc *tx = rx ? user_create("ipcpeer", arg) : 0;
+        if(!tx) {
+            pr_err("IPC 测试进程创建失败\n");
+            return;
+        }
+        uint64 prx = rx->pid, ptx = tx->pid;
+        proc_ready(rx);
+        proc_ready(tx);
+        proc_wait(prx);
+        proc_wait(ptx);
+        chan_close(id);
+    }
+
+    // 关闭后重建的通道沿用同一 id：已映射旧通道的进程再映射时要换成新的共享页
+    int id = chan_create();
+    struct proc *p = id < 0 ? 0 : user_create("ipcpeer", (uint64)id);
+    if(!p) {
+        pr_err("IPC 测试进程创建失败\n");
+        return;
+    }
+    uint64 va = chan_map(p, id);
+    uint8 *old = va ? uvm_lookup(p, va, 0) : 0;
+    chan_close(id);
+    int id2 = chan_create();
+    uint64 va2 = id2 == id ? chan_map(p, id2) : 0;
+    uint8 *cur = va2 ? uvm_lookup(p, va2, 0) : 0;
+    if(!old || !cur || cur == old)
+        pr_err("IPC 通道重建后映射的仍是旧共享页\n");
+    // 消息数为 0，ipcpeer 打开通道后直接退出
+    uint64 pid = p->pid;
+    proc_ready(p);
+    proc_wait(pid);
+    if(id2 >= 0)
+        chan_close(id2);
+
+    int ep = ep_create();
+    struct proc *client = ep < 0 ? 0 : user_create("pingpong", (uint64)ep | 1000UL << 32);
+    struct proc *server = client ? user_create("pingpong", (uint64)ep | 1UL << 8) : 0;
+    if(!server) {
+        pr_err("同步调用测试进程创建失败\n");
+        return;
+    }
+    uint64 pc = client->pid, ps = server->pid;
+    proc_ready(client);
+    proc_ready(server);
+    proc_wait(pc);
+    proc_wait(ps);
+    pr_info("IPC 测试完成\n");
+}
+
+// 块层：倒序提交 8 个相邻扇区的读请求，应当合并成一个发给驱动，内容与一次读 8 个扇区相同
+void test_blk(void) {
+    struct blk_dev *d = blk_lookup("vda");
+    char *a = alloc_pages(1), *b = alloc_pages(1);
+    struct blk_req reqs[8];
+    struct blk_stats st0, st1;
+    if(!d || !a || !b) {
+        pr_err("块层测试初始化失败\n");
+        return;
+    }
+    for(int i = 0; i < 8; i++) {
+        reqs[i].buf = a + (7 - i) * 512;
+        reqs[i].sector = 7 - i;
+        reqs[i].nsect = 1;
+        reqs[i].op = BLK_READ;
+    }
+    blk_get_stats(d, &st0);
+    int r = blk_submit_wait(d, reqs, 8);
+    blk_get_stats(d, &st1);
+    int ok = r == 0 && blk_rw(d, b, 0, 8, 0) == 0 && memcmp(a, b, 4096) == 0;
+    pr_info("块层测试%s：%s 调度器，8 个请求合并 %lu 次，发出 %lu 个\n", ok ? "正确" : "错误",
+            d->sched->name, st1.merges - st0.merges, st1.dispatched - st0.dispatched);
+    free_pages(a, 1);
+    free_pages(b, 1);
+}
+
+// 异步 I/O 环：写好测试文件后由 iobench 经环读一批并检查内容，再经环追加一段并检查结果，出错时自己打印
+void test_ioring(void) {
+    char buf[512];
+    int ok = 1;
+    for(int off = 0; off < 65536; off += 512) {
+        for(int i = 0; i < 512; i++)
+            buf[i] = ((off + i) >> 9) + off + i;
+        if(fat_write_file("IOBENCH BIN", buf, 512, off) != 512)
+            ok = 0;
+    }
+    if(fat_file_size("IOBENCH BIN") != 65536)
+        ok = 0;
+    // 64 次读，追加检查（iobench.c 的 IOBENCH_APPEND）
+    struct proc *p = ok ? user_create("iobench", 64 | 1UL << 40) : 0;
+    if(!p) {
+        pr_err("I/O 环测试文件创建失败\n");
+        return;
+    }
+    uint64 pid = p->pid;
+    proc_ready(p);
+    proc_wait(pid);
+    pr_info("I/O 环测试完成\n");
 }
 
 void test_proc_and_mm(void) {
@@ -205,48 +450,102 @@ void test_proc_and_mm(void) {
     struct proc *p3 = proc_alloc();
 
     if(!p1 || !p2 || !p3) {
-        uart_puts("进程分配失败！\n");
+        pr_err("进程分配失败！\n");
         return;
     }
 
     // 每个进程请求16kb栈
-    void *stack1 = alloc_pages(4);
-    void *stack2 = alloc_pages(4);
-    void *stack3 = alloc_pages(4);
+    void *stack1 = alloc_pages(KSTACK_PAGES);
+    void *stack2 = alloc_pages(KSTACK_PAGES);
+    void *stack3 = alloc_pages(KSTACK_PAGES);
 
     // 初始化进程栈和上下文
-    init_proc_stack(p1, proc1_func, stack1, 16 * 1024);
-    init_proc_stack(p2, proc2_func, stack2, 16 * 1024);
-    init_proc_stack(p3, proc3_func, stack3, 16 * 1024);
+    init_proc_stack(p1, proc1_func, stack1, KSTACK_SIZE);
+    init_proc_stack(p2, proc2_func, stack2, KSTACK_SIZE);
+    init_proc_stack(p3, proc3_func, stack3, KSTACK_SIZE);
 
     // 将进程加入就绪队列
-    p1->state = RUNNABLE;
-    p2->state = RUNNABLE;
-    p3->state = RUNNABLE;
+    proc_ready(p1);
+    proc_ready(p2);
+    proc_ready(p3);
+}
 
+// 延后执行的初始化：设备探测和文件系统挂载不影响第一个进程就绪，
+// 放到调度器启动后的内核进程中完成
+static void kinit(void) {
+    boot_mark("first process");
+    // 初始化 virtio 块设备
+    virtio_blk_init();
+    boot_mark("virtio_blk_init");
+    // 初始化 FAT 文件系统
+    fat_init();
+    boot_mark("fat_init");
+    boot_report();
 
-    // 启动调度器
-    scheduler();
+#ifdef CONFIG_BENCH
+    // 基准测试内核：运行全部测试后关机
+    bench_start();
+#else
+    // 串口输出耗时测试
+    test_uart_log();
+    // 块层合并测试
+    test_blk();
+    // FAT 文件系统测试
+    test_fat();
+    // FP/SIMD 惰性切换测试
+    test_fpsimd();
+    // 用户态进程测试
+    test_user();
+    // 定时器测试
+    test_timer();
+    // 文件映射测试
+    test_mmap();
+    // 进程间通信测试
+    test_ipc();
+    // 异步 I/O 环测试
+    test_ioring();
+#endif
 }
 
 void main(void) {
     // 初始化串口
     uart_init();
+    boot_mark("uart_init");
+    // 安装异常向量表并初始化中断控制器
+    trap_init();
+    gic_init();
+    timer_init();
+    boot_mark("trap/gic_init");
     // 初始化进程管理
     proc_init();
+    boot_mark("proc_init");
+#ifndef CONFIG_BENCH
+    // 开始记录事件跟踪，控制台按 Ctrl-T 转储
+    trace_start();
+#endif
     // 初始化内存管理
     init_mm();
-    // 初始化 virtio 块设备
-    virtio_blk_init();
-    // 初始化 FAT 文件系统
-    fat_init();
+    boot_mark("init_mm");
+    // 换掉启动时的恒等映射，之后低地址只属于用户进程
+    vm_init();
 
-    // FAT 文件系统测试
-    test_fat();
+    // 设备和文件系统的初始化交给 kinit 进程，排在最前面运行
+    struct proc *p = kthread_create(kinit);
+    if(!p)
+        panic("main: cannot create kinit");
+    proc_ready(p);
+#ifndef CONFIG_BENCH
     // 测试进程管理和内存管理
     test_proc_and_mm();
-    
+#endif
+    boot_mark("scheduler");
+
+    // 启动调度器，不会返回
+    scheduler();
+
     // 如果调度器返回（不应该发生），则停止系统
-    uart_puts("主函数返回，系统已停止。\n");
-    while(1);
+    pr_err("主函数返回，系统已停止。\n");
+    log_flush();
+    for(;;)
+        asm volatile("wfi");
 }
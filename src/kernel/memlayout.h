@@ -4,18 +4,40 @@
 
 // QEMU virt 机器的内存布局
 // 0x00000000 -- QEMU 提供的启动 ROM
+// 0x08000000 -- GICv3 分发器
+// 0x080a0000 -- GICv3 重分发器
 // 0x09000000 -- UART0
 // 0x0a000000 -- VIRTIO0 (virtio 设备)
-// 0x40000000 -- 内核加载地址
+// 0x40000000 -- RAM 起始
+// 0x40080000 -- 内核加载地址（QEMU 把裸二进制内核放在 RAM 起始 + 0x80000）
 
-#define MEM_START    0x40000000L               // 扩展内存起始地址
-#define MEM_END   (MEM_START + 128*1024*1024)  // 扩展内存结束地址
+// 内核虚拟地址布局：物理地址 pa 映射在 KERNBASE + pa（TTBR1_EL1），
+// 内核代码、数据、设备寄存器和分配器返回的页都用这个线性映射访问；
+// 低地址（TTBR0_EL1）留给用户进程。主机构建定义 KERNBASE=0，虚拟地址即物理地址
+#ifndef KERNBASE
+#define KERNBASE 0xffff000000000000L
+#endif
+
+#define P2V(a) ((uint64)(a) + KERNBASE)
+#define V2P(a) ((uint64)(a) - KERNBASE)
+
+#define MEM_START    0x40000000L               // 扩展内存起始物理地址
+#define MEM_END   (MEM_START + 128*1024*1024)  // 扩展内存结束物理地址
 #define TOTAL_MEM   (MEM_END - MEM_START)      // 总内存大小
 
-// UART 寄存器物理地址
-#define UART0 0x09000000L
+// GICv3 寄存器地址
+#define GICD P2V(0x08000000L)
+#define GICR P2V(0x080a0000L)
+
+// UART 寄存器地址
+#define UART0 P2V(0x09000000L)
+#define UART0_IRQ 33  // SPI 1
+
+// VIRTIO 设备地址
+#define VIRTIO0 P2V(0x0a000000L)
+#define VIRTIO0_IRQ 48  // SPI 16
 
-// VIRTIO 设备物理地址
-#define VIRTIO0 0x0a000000L
+// 通用定时器虚拟定时器中断（PPI）
+#define TIMER_IRQ 27
 
 #endif
@@ -1,13 +1,57 @@
 #include "memlayout.h"
 #include "mm.h"
-#include "uart.h"
+#include "trace.h"
+
+// 主机构建（src/host）由 host_compat.h 提供下面的钩子：线程号充当 CPU 号，全局位图用互斥锁保护
+#ifndef HOST_COMPAT
+#include "aarch64.h"
+#include "proc.h"
+#define MM_NCPU          NCPU
+#define mm_cpu()         cpuid()
+// 每 CPU 缓存只需防止本核中断打断
+#define pcp_lock()       push_off()
+#define pcp_unlock()     pop_off()
+// 只有一个核，全局位图同样只需关中断，调用时已在 pcp_lock 之内
+#define global_lock()
+#define global_unlock()
+#endif
 
 #define PAGE_SIZE 4096 // 页大小定义
 #define TOTAL_PAGES (TOTAL_MEM / PAGE_SIZE) // 内存总页数
 #define BITMAP_SIZE (TOTAL_PAGES / 8) // 管理页表的位图大小
 
+// 分配器管理整个 RAM，返回线性映射中的内核虚拟地址
+#define RAM_BASE P2V(MEM_START)
+#define RAM_END  P2V(MEM_END)
+
 static uint8 bitmap[BITMAP_SIZE];
 
+// 每页的引用计数：alloc_pages 置 1，共享（写时复制）时增加，
+// page_put 减到 0 时释放。只对单页分配有意义
+static uint32 page_ref[TOTAL_PAGES];
+
+// 每 CPU 的单页缓存：空闲页用页内开头 8 字节串成链表，位图中仍记为已分配。
+// 单页分配和释放只访问本 CPU 的链表；缓存空了从全局位图一次补充 PCP_BATCH 页，
+// 超过高水位 PCP_HIGH 时一次还回 PCP_BATCH 页
+#define PCP_BATCH 16
+#define PCP_HIGH  64
+
+struct pcp {
+    void *list;
+    uint32 count;
+} __attribute__((aligned(64)));   // 各 CPU 的缓存不共享缓存行
+
+static struct pcp pcps[MM_NCPU];
+static int pcp_enabled = 1;
+
+// 预先清零的空闲页池，同样串成链表。空闲时由调度器调用 mm_zero_fill 补满，
+// 带 ALLOC_ZERO 的单页申请直接取用，省去申请路径上的清零
+#define ZERO_POOL_TARGET 64
+
+static void *zero_list;
+static uint32 zero_count;
+static struct zero_stats zstats;
+
 static inline void bitmap_set(uint32 index) {
     bitmap[index / 8] |= (1 << (index % 8));
 }
@@ -23,14 +67,32 @@ static inline uint32 bitmap_test(uint32 index) {
 // 内核结束位置
 extern char end[];
 
+// 按 8 字节写入对齐的主体部分，首尾不对齐的部分逐字节处理
 void memset(void *dest, char c, uint64 len) {
-    for (uint8 *d = dest; len > 0; d++, len--)
+    uint8 *d = dest;
+    while (len > 0 && ((uint64)d & 7)) {
+        *d++ = c;
+        len--;
+    }
+    uint64 v = (uint8)c * 0x0101010101010101UL;
+    for (; len >= 8; d += 8, len -= 8)
+        *(uint64*)d = v;
+    for (; len > 0; d++, len--)
         *d = c;
 }
 
+// 源和目的同样对齐时按 8 字节拷贝
 void *memcpy(void *dest, const void *src, uint32 n) {
     uint8 *d = (uint8*)dest;
     const uint8 *s = (const uint8*)src;
+    if ((((uint64)d ^ (uint64)s) & 7) == 0) {
+        while (n > 0 && ((uint64)d & 7)) {
+            *d++ = *s++;
+            n--;
+        }
+        for (; n >= 8; d += 8, s += 8, n -= 8)
+            *(uint64*)d = *(const uint64*)s;
+    }
     for (uint32 i = 0; i < n; i++) d[i] = s[i];
     return dest;
 }
@@ -44,23 +106,44 @@ int memcmp(const void *s1, const void *s2, uint32 n) {
     return 0;
 }
 
+#ifndef HOST_COMPAT
+// 用 DC ZVA 按块清零整页，不必先把旧内容读进缓存。块大小由 DCZID_EL0 给出
+static void zero_page(void *page) {
+    uint64 dczid = r_dczid();
+    if (dczid & DCZID_DZP) {
+        memset(page, 0, PAGE_SIZE);
+        return;
+    }
+    uint64 bs = 4UL << (dczid & 0xf);
+    for (uint64 a = (uint64)page; a < (uint64)page + PAGE_SIZE; a += bs)
+        asm volatile("dc zva, %0" : : "r" (a) : "memory");
+}
+#else
+#define zero_page(page) memset(page, 0, PAGE_SIZE)
+#endif
+
 void init_mm(void) {
     memset(bitmap, 0, BITMAP_SIZE);
 
     // 计算内核占用页数，向上取整
     uint64 kernel_end = (uint64)end;
-    uint32 reserved_pages = (kernel_end - MEM_START + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32 reserved_pages = (kernel_end - RAM_BASE + PAGE_SIZE - 1) / PAGE_SIZE;
 
-    for (uint32 i = 0; i < reserved_pages; i++) {
+    // 整字节标记，剩余不足 8 页的逐位标记
+    memset(bitmap, 0xff, reserved_pages / 8);
+    for (uint32 i = reserved_pages & ~7U; i < reserved_pages; i++) {
         bitmap_set(i);
     }
 }
 
-// 申请连续页
-void* alloc_pages(uint32 number_of_pages) {
-    if (number_of_pages == 0 || number_of_pages > TOTAL_PAGES) return NULL;
-
+// 在全局位图中申请连续页，调用者持有 global_lock
+static void *global_alloc(uint32 number_of_pages) {
     for (uint32 i = 0; i <= TOTAL_PAGES - number_of_pages; i++) {
+        // 整字节已满时一次跳过 8 页
+        if ((i & 7) == 0 && bitmap[i / 8] == 0xff) {
+            i += 7;
+            continue;
+        }
         uint32 found = 1;
         for (uint32 j = 0; j < number_of_pages; j++) {
             if (bitmap_test(i + j)) {
@@ -70,26 +153,226 @@ void* alloc_pages(uint32 number_of_pages) {
             }
         }
         if (found) {
-            for (uint32 j = 0; j < number_of_pages; j++) {
+            for (uint32 j = 0; j < number_of_pages; j++)
                 bitmap_set(i + j);
+            return (void *)(RAM_BASE + i * PAGE_SIZE);
+        }
+    }
+    return NULL;
+}
+
+static void global_free(void *addr, uint32 number_of_pages) {
+    uint32 index = ((uint64)addr - RAM_BASE) / PAGE_SIZE;
+    for (uint32 i = 0; i < number_of_pages; i++)
+        bitmap_clear(index + i);
+}
+
+// 把本 CPU 缓存里的 n 页还给全局位图，调用者持有 pcp_lock
+static void pcp_drain(struct pcp *pcp, uint32 n) {
+    global_lock();
+    while (n-- > 0 && pcp->list) {
+        void *page = pcp->list;
+        pcp->list = *(void **)page;
+        pcp->count--;
+        global_free(page, 1);
+    }
+    global_unlock();
+}
+
+// 从全局位图补充 PCP_BATCH 页，调用者持有 pcp_lock
+static void pcp_refill(struct pcp *pcp) {
+    global_lock();
+    for (int i = 0; i < PCP_BATCH; i++) {
+        void *page = global_alloc(1);
+        if (!page)
+            break;
+        *(void **)page = pcp->list;
+        pcp->list = page;
+        pcp->count++;
+    }
+    global_unlock();
+}
+
+// 从零页池取一页，调用者持有 pcp_lock
+static void *zero_pop(void) {
+    global_lock();
+    void *page = zero_list;
+    if (page) {
+        zero_list = *(void **)page;
+        zero_count--;
+        // 链表指针占用了开头 8 字节
+        *(uint64 *)page = 0;
+    }
+    global_unlock();
+    return page;
+}
+
+// 从本 CPU 缓存或全局位图取页，不设置引用计数，调用者持有 pcp_lock
+static void *page_take(uint32 number_of_pages) {
+    void *page;
+    struct pcp *pcp = &pcps[mm_cpu()];
+    if (number_of_pages == 1 && pcp_enabled) {
+        if (!pcp->list)
+            pcp_refill(pcp);
+        page = pcp->list;
+        if (page) {
+            pcp->list = *(void **)page;
+            pcp->count--;
+        }
+    } else {
+        global_lock();
+        page = global_alloc(number_of_pages);
+        global_unlock();
+        // 连续页不够时，本 CPU 缓存和零页池里的页可能正好补上空洞
+        if (!page && (pcp->count || zero_count)) {
+            pcp_drain(pcp, pcp->count);
+            void *z;
+            while ((z = zero_pop()) != NULL) {
+                global_lock();
+                global_free(z, 1);
+                global_unlock();
             }
-            return (void *)(MEM_START + i * PAGE_SIZE);
+            global_lock();
+            page = global_alloc(number_of_pages);
+            global_unlock();
         }
     }
-    return NULL; // 分配失败
+    return page;
+}
+
+// 申请连续页
+void* alloc_pages(uint32 number_of_pages) {
+    return alloc_pages_flags(number_of_pages, 0);
+}
+
+// 申请连续页，flags 为 ALLOC_ZERO 时返回的页全部清零
+void *alloc_pages_flags(uint32 number_of_pages, int flags) {
+    if (number_of_pages == 0 || number_of_pages > TOTAL_PAGES) return NULL;
+
+    void *page = NULL;
+    int zeroed = 0;
+    pcp_lock();
+    if ((flags & ALLOC_ZERO) && number_of_pages == 1) {
+        page = zero_pop();
+        zeroed = page != NULL;
+        if (zeroed)
+            zstats.hits++;
+        else
+            zstats.misses++;
+    }
+    if (!page)
+        page = page_take(number_of_pages);
+    // 其余空闲页都用完时零页池里的页也可以分出去
+    if (!page && number_of_pages == 1)
+        zeroed = (page = zero_pop()) != NULL;
+    pcp_unlock();
+    if (!page)
+        return NULL; // 分配失败
+
+    if ((flags & ALLOC_ZERO) && !zeroed) {
+        for (uint32 j = 0; j < number_of_pages; j++)
+            zero_page((uint8 *)page + j * PAGE_SIZE);
+    }
+    uint32 index = ((uint64)page - RAM_BASE) / PAGE_SIZE;
+    for (uint32 j = 0; j < number_of_pages; j++)
+        page_ref[index + j] = 1;
+    trace(TRACE_PAGE_ALLOC, (uint64)page, number_of_pages);
+    return page;
+}
+
+// 清零一页放进零页池，池已满或没有空闲页时返回 0。
+// 每次只清一页，调度器在两次调用之间打开中断，不会长时间关中断
+int mm_zero_fill(void) {
+    if (zero_count >= ZERO_POOL_TARGET)
+        return 0;
+    pcp_lock();
+    void *page = page_take(1);
+    pcp_unlock();
+    if (!page)
+        return 0;
+    zero_page(page);
+    pcp_lock();
+    global_lock();
+    *(void **)page = zero_list;
+    zero_list = page;
+    zero_count++;
+    zstats.filled++;
+    global_unlock();
+    pcp_unlock();
+    return 1;
+}
+
+void mm_zero_get_stats(struct zero_stats *st) {
+    *st = zstats;
+    st->pooled = zero_count;
 }
 
 // 释放连续页
 void free_pages(void *addr, uint32 number_of_pages) {
     uint64 page_addr = (uint64)addr;
-    if (page_addr < MEM_START || page_addr >= MEM_END || (page_addr - MEM_START) % PAGE_SIZE != 0) {
+    if (page_addr < RAM_BASE || page_addr >= RAM_END || (page_addr - RAM_BASE) % PAGE_SIZE != 0) {
         return; // 非法地址
     }
-    uint32 index = (page_addr - MEM_START) / PAGE_SIZE;
+    uint32 index = (page_addr - RAM_BASE) / PAGE_SIZE;
     if (index + number_of_pages > TOTAL_PAGES) {
         return; // 越界
     }
-    for (uint32 i = 0; i < number_of_pages; i++) {
-        bitmap_clear(index + i);
+    for (uint32 i = 0; i < number_of_pages; i++)
+        page_ref[index + i] = 0;
+    trace(TRACE_PAGE_FREE, page_addr, number_of_pages);
+
+    pcp_lock();
+    struct pcp *pcp = &pcps[mm_cpu()];
+    if (number_of_pages == 1 && pcp_enabled) {
+        *(void **)addr = pcp->list;
+        pcp->list = addr;
+        pcp->count++;
+        if (pcp->count > PCP_HIGH)
+            pcp_drain(pcp, PCP_BATCH);
+    } else {
+        global_lock();
+        global_free(addr, number_of_pages);
+        global_unlock();
+    }
+    pcp_unlock();
+}
+
+// 开关每 CPU 缓存，关闭时单页也直接走全局位图，用于对比测量。
+// 只清空调用者所在 CPU 的缓存，其他 CPU 的缓存留到重新打开后继续使用
+void mm_set_pcp(int enabled) {
+    pcp_lock();
+    if (!enabled)
+        pcp_drain(&pcps[mm_cpu()], pcps[mm_cpu()].count);
+    pcp_enabled = enabled;
+    pcp_unlock();
+}
+
+// 空闲页数，包括各 CPU 缓存和零页池中的页
+uint64 nr_free_pages(void) {
+    uint64 n = 0;
+    for (uint32 i = 0; i < TOTAL_PAGES; i++) {
+        if (!bitmap_test(i)) n++;
     }
-}
\ No newline at end of file
+    for (int c = 0; c < MM_NCPU; c++)
+        n += pcps[c].count;
+    return n + zero_count;
+}
+
+static inline uint32 page_index(void *page) {
+    return ((uint64)page - RAM_BASE) / PAGE_SIZE;
+}
+
+// 增加一页的引用
+void page_get(void *page) {
+    page_ref[page_index(page)]++;
+}
+
+// 减少一页的引用，最后一个引用释放该页
+void page_put(void *page) {
+    if (--page_ref[page_index(page)] == 0)
+        free_pages(page, 1);
+}
+
+uint32 page_refcount(void *page) {
+    return page_ref[page_index(page)];
+}
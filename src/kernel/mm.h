@@ -5,12 +5,30 @@
 
 #define NULL ((void *)0)
 
+// alloc_pages_flags 的标志
+#define ALLOC_ZERO 1   // 返回清零的页，单页优先取自预先清零的页池
+
+struct zero_stats {
+    uint64 pooled;   // 池中现有页数
+    uint64 filled;   // 空闲时清零放入池中的页数
+    uint64 hits;     // ALLOC_ZERO 单页申请命中池
+    uint64 misses;   // 池空，在申请路径上清零
+};
+
 // 函数声明
 void memset(void *dest, char c, uint64 len);
 void *memcpy(void *dest, const void *src, uint32 n);
 int memcmp(const void *s1, const void *s2, uint32 n);
 void init_mm(void);
 void* alloc_pages(uint32 number_of_pages);
+void *alloc_pages_flags(uint32 number_of_pages, int flags);
 void free_pages(void *addr, uint32 number_of_pages);
+uint64 nr_free_pages(void);
+void mm_set_pcp(int enabled);
+int mm_zero_fill(void);
+void mm_zero_get_stats(struct zero_stats *st);
+void page_get(void *page);
+void page_put(void *page);
+uint32 page_refcount(void *page);
 
 #endif
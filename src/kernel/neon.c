@@ -0,0 +1,45 @@
+#include <arm_neon.h>
+#include "neon.h"
+
+// 字节累加校验和，每次处理 16 字节
+uint32 neon_checksum(const void *buf, uint64 len) {
+    const uint8 *p = buf;
+    uint32x4_t acc = vdupq_n_u32(0);
+    while(len >= 16) {
+        uint16x8_t s = vpaddlq_u8(vld1q_u8(p));
+        acc = vpadalq_u16(acc, s);
+        p += 16;
+        len -= 16;
+    }
+    uint32 sum = vaddvq_u32(acc);
+    while(len--)
+        sum += *p++;
+    return sum;
+}
+
+#define ALL_V "0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15," \
+              "16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31"
+
+// 把 v 写入全部 32 个向量寄存器，用于检验切换后状态是否保留
+void fpsimd_fill(uint64 v) {
+    asm volatile(".irp n," ALL_V "\n"
+                 "dup v\\n\\().2d, %0\n"
+                 ".endr"
+                 : : "r" (v)
+                 : "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
+                   "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",
+                   "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23",
+                   "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31");
+}
+
+// 返回值不等于 v 的向量寄存器个数
+int fpsimd_check(uint64 v) {
+    uint64 bad = 0;
+    asm volatile(".irp n," ALL_V "\n"
+                 "mov x9, v\\n\\().d[1]\n"
+                 "cmp x9, %1\n"
+                 "cinc %0, %0, ne\n"
+                 ".endr"
+                 : "+r" (bad) : "r" (v) : "x9", "cc");
+    return bad;
+}
@@ -0,0 +1,14 @@
+#ifndef _NEON_H
+#define _NEON_H
+
+#include "types.h"
+
+// neon.c 单独以允许 FP/SIMD 的选项编译，其余内核代码仍是 +nofp。
+// 调用这些函数的进程第一次使用 FP 时会陷入并获得寄存器。
+
+// 函数声明
+uint32 neon_checksum(const void *buf, uint64 len);
+void fpsimd_fill(uint64 v);
+int fpsimd_check(uint64 v);
+
+#endif
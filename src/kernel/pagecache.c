@@ -0,0 +1,222 @@
+#include "pagecache.h"
+#include "fat.h"
+#include "mm.h"
+#include "printk.h"
+#include "vm.h"
+
+#ifndef HOST_COMPAT
+#include "wait.h"
+static struct mutex pcache_mutex = MUTEX_INIT;
+#define pcache_lock()    mutex_lock(&pcache_mutex)
+#define pcache_unlock()  mutex_unlock(&pcache_mutex)
+#endif
+
+// 缓存页的物理页另由 mm.c 计引用：缓存本身持有一个，每个映射它的页表项再各持有一个。
+// 引用数为 1 的页没有被映射，才能淘汰；淘汰按最近最少使用的顺序，脏页先写回。
+// fat_read_file 经过缓存读；fat_write_file 和 I/O 环的异步写直接写磁盘，同时用 pcache_update
+// 改写已缓存的页，映射着这些页的进程也能看到
+
+#define PCACHE_HASH 64
+
+struct pcache_page {
+    char name[11];
+    uint32 index;                   // 文件内页号
+    uint8 *page;                    // 0 表示空闲
+    int dirty;
+    struct pcache_page *hash_next;
+    struct pcache_page *lru_prev;   // 链表头是最近使用的
+    struct pcache_page *lru_next;
+};
+
+static struct pcache_page pages[PCACHE_PAGES];
+static struct pcache_page *hash[PCACHE_HASH];
+static struct pcache_page lru = { .lru_prev = &lru, .lru_next = &lru };
+static struct pcache_stats stats;
+
+static uint32 pcache_hash(const char *name, uint32 index) {
+    uint32 h = index;
+    for(int i = 0; i < 11; i++)
+        h = h * 31 + (uint8)name[i];
+    return h % PCACHE_HASH;
+}
+
+static void lru_remove(struct pcache_page *pc) {
+    pc->lru_prev->lru_next = pc->lru_next;
+    pc->lru_next->lru_prev = pc->lru_prev;
+}
+
+static void lru_push(struct pcache_page *pc) {
+    pc->lru_next = lru.lru_next;
+    pc->lru_prev = &lru;
+    lru.lru_next->lru_prev = pc;
+    lru.lru_next = pc;
+}
+
+static struct pcache_page *pcache_lookup(const char *name, uint32 index) {
+    for(struct pcache_page *pc = hash[pcache_hash(name, index)]; pc; pc = pc->hash_next)
+        if(pc->index == index && memcmp(pc->name, name, 11) == 0)
+            return pc;
+    return 0;
+}
+
+// 把页的内容写回文件，文件末尾之外的部分不写。
+// 调用者知道的引用（缓存本身和调用者已改成只读的映射）共 owned 个，
+// 除此之外还有映射时页可能仍可写，保留脏标记
+static int pcache_flush(struct pcache_page *pc, uint32 owned) {
+    if(!pc->dirty)
+        return 0;
+    if(fat_write_range(pc->name, pc->page, PAGE_SIZE, pc->index * PAGE_SIZE) < 0)
+        return -1;
+    stats.writebacks++;
+    pc->dirty = page_refcount(pc->page) > owned;
+    return 0;
+}
+
+// 把页从散列表和 LRU 链上摘下并释放，槽位变为空闲
+static void pcache_free(struct pcache_page *pc) {
+    struct pcache_page **pp = &hash[pcache_hash(pc->name, pc->index)];
+    while(*pp != pc)
+        pp = &(*pp)->hash_next;
+    *pp = pc->hash_next;
+    lru_remove(pc);
+    page_put(pc->page);
+    pc->page = 0;
+}
+
+// 淘汰一个没有被映射的页，返回空出的槽位；全部被映射或写回失败时返回 0
+static struct pcache_page *pcache_evict(void) {
+    for(struct pcache_page *pc = lru.lru_prev; pc != &lru; pc = pc->lru_prev) {
+        if(page_refcount(pc->page) != 1)
+            continue;
+        if(pcache_flush(pc, 1) < 0)
+            continue;
+        pcache_free(pc);
+        stats.evictions++;
+        return pc;
+    }
+    return 0;
+}
+
+// 返回文件 name 第 index 页的缓存页（内核地址），不在缓存中时从磁盘读入，
+// 文件末尾之后的部分填零。调用者要长期使用这一页时应自己 page_get
+void *pcache_get(const char *name, uint32 index) {
+    pcache_lock();
+    struct pcache_page *pc = pcache_lookup(name, index);
+    if(pc) {
+        stats.hits++;
+        lru_remove(pc);
+        lru_push(pc);
+        pcache_unlock();
+        return pc->page;
+    }
+
+    int size = fat_file_size(name);
+    if(size < 0 || (uint64)index * PAGE_SIZE >= (uint64)size)
+        goto fail;
+    pc = 0;
+    for(int i = 0; i < PCACHE_PAGES && !pc; i++)
+        if(!pages[i].page)
+            pc = &pages[i];
+    if(!pc && !(pc = pcache_evict()))
+        goto fail;
+    uint8 *page = alloc_pages_flags(1, ALLOC_ZERO);
+    if(!page)
+        goto fail;
+    uint32 n = size - index * PAGE_SIZE;
+    if(n > PAGE_SIZE)
+        n = PAGE_SIZE;
+    if(fat_read_direct(name, page, n, index * PAGE_SIZE) != (int)n) {
+        free_pages(page, 1);
+        goto fail;
+    }
+    stats.misses++;
+    memcpy(pc->name, name, 11);
+    pc->index = index;
+    pc->page = page;
+    pc->dirty = 0;
+    uint32 h = pcache_hash(name, index);
+    pc->hash_next = hash[h];
+    hash[h] = pc;
+    lru_push(pc);
+    pcache_unlock();
+    return page;
+
+fail:
+    pcache_unlock();
+    return 0;
+}
+
+// 文件第 index 页是否在缓存中
+int pcache_cached(const char *name, uint32 index) {
+    pcache_lock();
+    int r = pcache_lookup(name, index) != 0;
+    pcache_unlock();
+    return r;
+}
+
+// 文件 [offset, offset + size) 已直接写到磁盘，把数据拷进其中已缓存的页。不改脏标记
+void pcache_update(const char *name, const void *buf, uint32 size, uint32 offset) {
+    pcache_lock();
+    for(uint32 done = 0; done < size; ) {
+        uint32 pos = offset + done;
+        uint32 n = PAGE_SIZE - pos % PAGE_SIZE;
+        if(n > size - done)
+            n = size - done;
+        struct pcache_page *pc = pcache_lookup(name, pos / PAGE_SIZE);
+        if(pc)
+            memcpy(pc->page + pos % PAGE_SIZE, (const uint8 *)buf + done, n);
+        done += n;
+    }
+    pcache_unlock();
+}
+
+// 写回全部脏页并清空缓存（换设备挂载时用），有页仍被映射或写回失败时返回 -1
+int pcache_drop(void) {
+    int r = 0;
+    pcache_lock();
+    for(int i = 0; i < PCACHE_PAGES; i++) {
+        struct pcache_page *pc = &pages[i];
+        if(!pc->page)
+            continue;
+        if(page_refcount(pc->page) != 1 || pcache_flush(pc, 1) < 0) {
+            r = -1;
+            continue;
+        }
+        pcache_free(pc);
+    }
+    pcache_unlock();
+    return r;
+}
+
+// 标记缓存页被修改过
+void pcache_dirty(const char *name, uint32 index) {
+    pcache_lock();
+    struct pcache_page *pc = pcache_lookup(name, index);
+    if(pc)
+        pc->dirty = 1;
+    pcache_unlock();
+}
+
+// 写回一页，调用者已把自己对这一页的映射改成只读
+int pcache_writeback(const char *name, uint32 index) {
+    pcache_lock();
+    struct pcache_page *pc = pcache_lookup(name, index);
+    int r = pc ? pcache_flush(pc, 2) : 0;
+    pcache_unlock();
+    return r;
+}
+
+// 写回全部脏页
+int pcache_sync(void) {
+    int r = 0;
+    pcache_lock();
+    for(int i = 0; i < PCACHE_PAGES; i++)
+        if(pages[i].page && pcache_flush(&pages[i], 1) < 0)
+            r = -1;
+    pcache_unlock();
+    return r;
+}
+
+void pcache_get_stats(struct pcache_stats *st) {
+    *st = stats;
+}
@@ -0,0 +1,29 @@
+#ifndef _PAGECACHE_H
+#define _PAGECACHE_H
+
+#include "types.h"
+
+// 页缓存：按（文件名，文件内页号）缓存 FAT 文件数据。fat_read_file 从缓存拷贝，
+// mmap 把缓存页直接映射给用户进程
+
+// 最多缓存的页数
+#define PCACHE_PAGES 256
+
+struct pcache_stats {
+    uint64 hits;        // 命中缓存
+    uint64 misses;      // 从磁盘读入
+    uint64 writebacks;  // 脏页写回
+    uint64 evictions;   // 淘汰
+};
+
+// 函数声明
+void *pcache_get(const char *name, uint32 index);
+int pcache_cached(const char *name, uint32 index);
+void pcache_update(const char *name, const void *buf, uint32 size, uint32 offset);
+int pcache_drop(void);
+void pcache_dirty(const char *name, uint32 index);
+int pcache_writeback(const char *name, uint32 index);
+int pcache_sync(void);
+void pcache_get_stats(struct pcache_stats *st);
+
+#endif
@@ -0,0 +1,94 @@
+#include "pid.h"
+#include "mm.h"
+#include "vm.h"
+
+// PID 分配：位图记录已用的 PID，从上次分配的位置往后循环查找，刚释放的 PID 不会马上被重用。
+// 摘要位图的每一位表示一个位图字是否已满，查找空闲 PID 最多扫描 PID_MAX / 4096 个摘要字
+// 和一个位图字，与存活进程数无关。
+// PID 到进程的映射是两级基数树：第一级按 PID 高位索引，第二级是按需分配的一页指针
+
+#define PID_WORDS (PID_MAX / 64)
+#define PID_LEAF  (PAGE_SIZE / sizeof(struct proc *))
+
+static uint64 pid_map[PID_WORDS] = { 1 };    // PID 0 保留
+static uint64 pid_full[PID_WORDS / 64];
+static uint32 pid_last;
+static struct proc **pid_tree[PID_MAX / PID_LEAF];
+
+// 从第 w 个位图字起找第一个未满的字，没有时返回 -1
+static int pid_free_word(uint32 w) {
+    for(uint32 s = w / 64; s < PID_WORDS / 64; s++) {
+        uint64 bits = ~pid_full[s];
+        if(s == w / 64)
+            bits &= ~0UL << (w % 64);
+        if(bits)
+            return s * 64 + __builtin_ctzl(bits);
+    }
+    return -1;
+}
+
+// 找 start 及之后的第一个空闲 PID，没有时返回 -1
+static int pid_find(uint32 start) {
+    uint32 w = start / 64;
+    uint64 bits = ~pid_map[w] & (~0UL << (start % 64));
+    if(bits)
+        return w * 64 + __builtin_ctzl(bits);
+    int fw = w + 1 < PID_WORDS ? pid_free_word(w + 1) : -1;
+    if(fw < 0)
+        return -1;
+    return fw * 64 + __builtin_ctzl(~pid_map[fw]);
+}
+
+// 给 p 分配 PID 并登记到基数树，PID 用完或内存不足时返回 -1
+int pid_alloc(struct proc *p) {
+    uint32 start = pid_last + 1 < PID_MAX ? pid_last + 1 : 1;
+    int pid = pid_find(start);
+    if(pid < 0)
+        pid = pid_find(1);
+    if(pid < 0)
+        return -1;
+
+    struct proc ***leaf = &pid_tree[pid / PID_LEAF];
+    if(!*leaf) {
+        if((*leaf = alloc_pages_flags(1, ALLOC_ZERO)) == 0)
+            return -1;
+    }
+    (*leaf)[pid % PID_LEAF] = p;
+
+    uint32 w = pid / 64;
+    pid_map[w] |= 1UL << (pid % 64);
+    if(pid_map[w] == ~0UL)
+        pid_full[w / 64] |= 1UL << (w % 64);
+    pid_last = pid;
+    return pid;
+}
+
+// 释放 PID；基数树的叶子页留着给以后的 PID 使用
+void pid_free(uint64 pid) {
+    if(pid == 0 || pid >= PID_MAX)
+        return;
+    uint32 w = pid / 64;
+    pid_map[w] &= ~(1UL << (pid % 64));
+    pid_full[w / 64] &= ~(1UL << (w % 64));
+    pid_tree[pid / PID_LEAF][pid % PID_LEAF] = 0;
+}
+
+// 按 PID 查找进程，不存在时返回 0
+struct proc *pid_lookup(uint64 pid) {
+    if(pid == 0 || pid >= PID_MAX)
+        return 0;
+    struct proc **leaf = pid_tree[pid / PID_LEAF];
+    return leaf ? leaf[pid % PID_LEAF] : 0;
+}
+
+// 返回大于 pid 的下一个已用 PID，没有时返回 0，用于遍历全部进程
+uint64 pid_next(uint64 pid) {
+    for(uint64 w = (pid + 1) / 64; w < PID_WORDS; w++) {
+        uint64 bits = pid_map[w];
+        if(w == (pid + 1) / 64)
+            bits &= ~0UL << ((pid + 1) % 64);
+        if(bits)
+            return w * 64 + __builtin_ctzl(bits);
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef _PID_H
+#define _PID_H
+
+#include "types.h"
+
+// PID 取值 1 到 PID_MAX - 1，0 保留
+#define PID_MAX 32768
+
+struct proc;
+
+// 函数声明
+int pid_alloc(struct proc *p);
+void pid_free(uint64 pid);
+struct proc *pid_lookup(uint64 pid);
+uint64 pid_next(uint64 pid);
+
+#endif
@@ -0,0 +1,129 @@
+#include "pmu.h"
+#include "printk.h"
+
+// PMCR_EL0 位定义
+#define PMCR_E  (1 << 0)  // 启用所有计数器
+#define PMCR_P  (1 << 1)  // 清零事件计数器
+#define PMCR_C  (1 << 2)  // 清零周期计数器
+#define PMCR_LC (1 << 6)  // 周期计数器 64 位溢出
+#define PMCR_N(x) (((x) >> 11) & 0x1f)  // 实现的事件计数器个数
+
+#define PMCNTEN_C (1U << 31)
+
+// 当前配置的事件编号
+static uint32 pmu_events[PMU_NEVENTS] = {
+    PMU_EV_INST_RETIRED,
+    PMU_EV_L1D_CACHE_REFILL,
+    PMU_EV_L1D_CACHE,
+    PMU_EV_L1D_TLB_REFILL,
+};
+
+// 实际可用的事件计数器个数，0 表示没有 PMU
+static int pmu_nevents;
+static int pmu_present;
+
+static void pmu_write_type(int idx, uint32 event) {
+    asm volatile("msr pmselr_el0, %0; isb" : : "r" ((uint64)idx));
+    // P=0、U=0：EL1 和 EL0 都计数
+    asm volatile("msr pmxevtyper_el0, %0; isb" : : "r" ((uint64)event));
+}
+
+static uint32 pmu_read_event(int idx) {
+    uint64 x;
+    asm volatile("msr pmselr_el0, %0; isb" : : "r" ((uint64)idx));
+    asm volatile("mrs %0, pmxevcntr_el0" : "=r" (x));
+    return x;
+}
+
+// 启用当前核心的周期计数器和事件计数器
+void pmu_init(void) {
+    uint64 dfr0;
+    asm volatile("mrs %0, id_aa64dfr0_el1" : "=r" (dfr0));
+    uint64 ver = (dfr0 >> 8) & 0xf;
+    if(ver == 0 || ver == 0xf) {
+        pr_warn("pmu: not implemented\n");
+        return;
+    }
+
+    uint64 pmcr;
+    asm volatile("mrs %0, pmcr_el0" : "=r" (pmcr));
+    pmu_nevents = PMCR_N(pmcr);
+    if(pmu_nevents > PMU_NEVENTS)
+        pmu_nevents = PMU_NEVENTS;
+
+    for(int i = 0; i < pmu_nevents; i++)
+        pmu_write_type(i, pmu_events[i]);
+    // 周期计数器在 EL0 和 EL1 都计数
+    asm volatile("msr pmccfiltr_el0, %0" : : "r" ((uint64)0));
+    asm volatile("msr pmcntenset_el0, %0" : : "r" ((uint64)(PMCNTEN_C | ((1U << pmu_nevents) - 1))));
+    asm volatile("msr pmcr_el0, %0; isb" : : "r" ((uint64)(PMCR_E | PMCR_P | PMCR_C | PMCR_LC)));
+    pmu_present = 1;
+
+    pr_info("pmu: cycle counter + %d event counters\n", pmu_nevents);
+}
+
+// 修改第 idx 个计数器的事件，已累计的值不再有意义
+void pmu_set_event(int idx, uint32 event) {
+    if(idx < 0 || idx >= PMU_NEVENTS)
+        return;
+    pmu_events[idx] = event;
+    if(idx < pmu_nevents)
+        pmu_write_type(idx, event);
+}
+
+// 读取当前计数值
+void pmu_read(struct pmu_counts *c) {
+    if(!pmu_present) {
+        c->cycles = 0;
+        for(int i = 0; i < PMU_NEVENTS; i++)
+            c->events[i] = 0;
+        return;
+    }
+    asm volatile("isb; mrs %0, pmccntr_el0" : "=r" (c->cycles));
+    for(int i = 0; i < PMU_NEVENTS; i++)
+        c->events[i] = i < pmu_nevents ? pmu_read_event(i) : 0;
+}
+
+// 把 start 以来的增量同时累加到 a 和 b（进程与 CPU）
+void pmu_account(struct pmu_counts *a, struct pmu_counts *b, const struct pmu_counts *start) {
+    struct pmu_counts now;
+    pmu_read(&now);
+    uint64 d = now.cycles - start->cycles;
+    a->cycles += d;
+    b->cycles += d;
+    for(int i = 0; i < PMU_NEVENTS; i++) {
+        // 事件计数器只有 32 位
+        d = (uint32)(now.events[i] - start->events[i]);
+        a->events[i] += d;
+        b->events[i] += d;
+    }
+}
+
+// 查找配置了某事件的计数器
+static int pmu_find(uint32 event) {
+    for(int i = 0; i < pmu_nevents; i++)
+        if(pmu_events[i] == event)
+            return i;
+    return -1;
+}
+
+// 打印一组计数值以及 IPC、L1D 缺失率
+void pmu_print(const char *name, uint64 id, const struct pmu_counts *c) {
+    char line[200];
+    int n = snprintf(line, sizeof(line), "%s %lu: cycles=%lu", name, id, c->cycles);
+    for(int i = 0; i < pmu_nevents && n < (int)sizeof(line); i++)
+        n += snprintf(line + n, sizeof(line) - n, " ev%02x=%lu", pmu_events[i], c->events[i]);
+
+    int inst = pmu_find(PMU_EV_INST_RETIRED);
+    if(inst >= 0 && c->cycles && n < (int)sizeof(line)) {
+        uint64 ipc = c->events[inst] * 100 / c->cycles;
+        n += snprintf(line + n, sizeof(line) - n, " ipc=%lu.%02lu", ipc / 100, ipc % 100);
+    }
+    int refill = pmu_find(PMU_EV_L1D_CACHE_REFILL);
+    int access = pmu_find(PMU_EV_L1D_CACHE);
+    if(refill >= 0 && access >= 0 && c->events[access] && n < (int)sizeof(line)) {
+        uint64 rate = c->events[refill] * 10000 / c->events[access];
+        n += snprintf(line + n, sizeof(line) - n, " l1d_miss=%lu.%02lu%%", rate / 100, rate % 100);
+    }
+    pr_info("%s\n", line);
+}
@@ -0,0 +1,28 @@
+#ifndef _PMU_H
+#define _PMU_H
+
+#include "types.h"
+
+// 同时计数的可配置事件个数
+#define PMU_NEVENTS 4
+
+// ARMv8 通用 PMU 事件编号
+#define PMU_EV_L1D_CACHE_REFILL 0x03
+#define PMU_EV_L1D_CACHE        0x04
+#define PMU_EV_L1D_TLB_REFILL   0x05
+#define PMU_EV_INST_RETIRED     0x08
+
+// 一组计数值：周期计数器加上可配置事件计数器
+struct pmu_counts {
+    uint64 cycles;
+    uint64 events[PMU_NEVENTS];
+};
+
+// 函数声明
+void pmu_init(void);
+void pmu_set_event(int idx, uint32 event);
+void pmu_read(struct pmu_counts *c);
+void pmu_account(struct pmu_counts *a, struct pmu_counts *b, const struct pmu_counts *start);
+void pmu_print(const char *name, uint64 id, const struct pmu_counts *c);
+
+#endif
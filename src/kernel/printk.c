@@ -0,0 +1,289 @@
+#include "printk.h"
+#include "aarch64.h"
+#include "proc.h"
+#include "uart.h"
+
+// 每个 CPU 一个日志环形缓冲区，大小必须是2的幂
+#define LOG_BUF_SIZE (16 * 1024)
+// 单条日志最大长度
+#define LOG_LINE_MAX 256
+
+// 记录头，后面紧跟 len 字节的文本
+struct log_hdr {
+    uint16 len;
+    uint8 level;
+    uint8 reserved;
+};
+
+// 只有本 CPU 写 head，只有排空者写 tail，两端都不加锁
+struct log_ring {
+    uint64 head;       // 生产者写到的位置
+    uint64 tail;       // 消费者读到的位置
+    uint64 dropped;    // 因缓冲区满丢弃的条数
+    uint64 reported;   // 已在控制台报告过的丢弃数
+    char buf[LOG_BUF_SIZE];
+};
+
+static struct log_ring log_rings[NCPU];
+
+// 低于该级别（数值更大）的日志不输出到控制台
+static int console_level = LOG_INFO;
+
+// 同一时刻只允许一个排空者
+static int draining;
+
+// 把无符号数按进制转换成字符串，返回长度
+static int fmt_uint(char *tmp, uint64 n, int base, int upper) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    int len = 0;
+    do {
+        tmp[len++] = digits[n % base];
+        n /= base;
+    } while(n);
+    return len;
+}
+
+// 支持 %d %u %x %X %p %s %c %%，可带 l 修饰、0 填充、左对齐和宽度
+int vsnprintf(char *buf, int size, const char *fmt, va_list ap) {
+    int pos = 0;
+#define PUT(ch) do { if(pos < size - 1) buf[pos] = (ch); pos++; } while(0)
+
+    for(; *fmt; fmt++) {
+        if(*fmt != '%') {
+            PUT(*fmt);
+            continue;
+        }
+        fmt++;
+        char pad = ' ';
+        int width = 0;
+        int lng = 0;
+        int left = 0;
+        if(*fmt == '-') {
+            left = 1;
+            fmt++;
+        }
+        if(*fmt == '0') {
+            pad = '0';
+            fmt++;
+        }
+        while(*fmt >= '0' && *fmt <= '9')
+            width = width * 10 + (*fmt++ - '0');
+        while(*fmt == 'l') {
+            lng = 1;
+            fmt++;
+        }
+
+        char tmp[24];
+        int len = 0;
+        int neg = 0;
+        const char *s = 0;
+        switch(*fmt) {
+            case 'd': {
+                long v = lng ? va_arg(ap, long) : va_arg(ap, int);
+                if(v < 0) {
+                    neg = 1;
+                    v = -v;
+                }
+                len = fmt_uint(tmp, (uint64)v, 10, 0);
+                break;
+            }
+            case 'u':
+                len = fmt_uint(tmp, lng ? va_arg(ap, uint64) : va_arg(ap, uint32), 10, 0);
+                break;
+            case 'x':
+            case 'X':
+                len = fmt_uint(tmp, lng ? va_arg(ap, uint64) : va_arg(ap, uint32), 16, *fmt == 'X');
+                break;
+            case 'p':
+                PUT('0');
+                PUT('x');
+                len = fmt_uint(tmp, (uint64)va_arg(ap, void *), 16, 0);
+                break;
+            case 's':
+                s = va_arg(ap, const char *);
+                if(s == 0)
+                    s = "(null)";
+                break;
+            case 'c':
+                tmp[0] = (char)va_arg(ap, int);
+                len = 1;
+                break;
+            case '%':
+                tmp[0] = '%';
+                len = 1;
+                break;
+            case 0:
+                fmt--;
+                continue;
+            default:
+                PUT('%');
+                tmp[0] = *fmt;
+                len = 1;
+                break;
+        }
+
+        if(s) {
+            int slen = 0;
+            while(s[slen])
+                slen++;
+            for(int i = slen; !left && i < width; i++)
+                PUT(' ');
+            for(int i = 0; i < slen; i++)
+                PUT(s[i]);
+            for(int i = slen; left && i < width; i++)
+                PUT(' ');
+            continue;
+        }
+        int total = len + neg;
+        if(left)
+            pad = ' ';
+        if(neg && pad == '0')
+            PUT('-');
+        for(int i = total; !left && i < width; i++)
+            PUT(pad);
+        if(neg && pad == ' ')
+            PUT('-');
+        // fmt_uint 生成的是逆序字符串（%c/%% 只有一个字符）
+        while(len > 0)
+            PUT(tmp[--len]);
+        for(int i = total; left && i < width; i++)
+            PUT(' ');
+    }
+#undef PUT
+
+    if(size > 0)
+        buf[pos < size ? pos : size - 1] = '\0';
+    return pos;
+}
+
+int snprintf(char *buf, int size, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+// 格式化后写入本 CPU 的环形缓冲区，不访问 UART
+void printk(int level, const char *fmt, ...) {
+    char line[LOG_LINE_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if(len > LOG_LINE_MAX - 1)
+        len = LOG_LINE_MAX - 1;
+
+    struct log_hdr hdr = { len, level, 0 };
+    uint64 need = sizeof(hdr) + len;
+
+    // 同一 CPU 上的中断处理也可能写日志，短暂关中断保证单生产者
+    push_off();
+    struct log_ring *r = &log_rings[cpuid()];
+    uint64 head = r->head;
+    uint64 tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if(LOG_BUF_SIZE - (head - tail) < need) {
+        r->dropped++;
+        pop_off();
+        return;
+    }
+    const char *src = (const char *)&hdr;
+    for(uint64 i = 0; i < sizeof(hdr); i++)
+        r->buf[(head + i) % LOG_BUF_SIZE] = src[i];
+    head += sizeof(hdr);
+    for(int i = 0; i < len; i++)
+        r->buf[(head + i) % LOG_BUF_SIZE] = line[i];
+    // 记录内容写完后才发布新的 head
+    __atomic_store_n(&r->head, head + len, __ATOMIC_RELEASE);
+    pop_off();
+}
+
+void log_set_console_level(int level) {
+    console_level = level;
+}
+
+// 控制台输出 s 要占用的发送缓冲区空间，换行展开成 \r\n
+static uint64 console_cost(const char *s) {
+    uint64 n = 0;
+    for(; *s; s++)
+        n += *s == '\n' ? 2 : 1;
+    return n;
+}
+
+// 把所有 CPU 缓冲区中的日志送到控制台，最多占用 budget 字节的发送缓冲区。
+// 放不下的记录留在环里；返回 1 表示送出了一部分且还有剩余
+static int drain(uint64 budget) {
+    if(__atomic_exchange_n(&draining, 1, __ATOMIC_ACQUIRE))
+        return 0;
+
+    int sent = 0, more = 0;
+    for(int cpu = 0; cpu < NCPU && !more; cpu++) {
+        struct log_ring *r = &log_rings[cpu];
+        uint64 tail = r->tail;
+        uint64 head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        while(tail != head) {
+            struct log_hdr hdr;
+            char *dst = (char *)&hdr;
+            for(uint64 i = 0; i < sizeof(hdr); i++)
+                dst[i] = r->buf[(tail + i) % LOG_BUF_SIZE];
+
+            char line[LOG_LINE_MAX];
+            for(int i = 0; i < hdr.len; i++)
+                line[i] = r->buf[(tail + sizeof(hdr) + i) % LOG_BUF_SIZE];
+            line[hdr.len] = '\0';
+            uint64 cost = hdr.level <= console_level ? console_cost(line) : 0;
+            if(cost > budget) {
+                more = 1;
+                break;
+            }
+            budget -= cost;
+            tail += sizeof(hdr) + hdr.len;
+            // 先释放空间再做慢速输出
+            __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+            if(cost) {
+                uart_puts(line);
+                sent = 1;
+            }
+        }
+
+        uint64 dropped = r->dropped;
+        if(!more && dropped != r->reported) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "[log] cpu%d dropped %lu messages\n",
+                     cpu, dropped - r->reported);
+            if(console_cost(msg) > budget) {
+                more = 1;
+            } else {
+                budget -= console_cost(msg);
+                uart_puts(msg);
+                sent = 1;
+                r->reported = dropped;
+            }
+        }
+    }
+
+    __atomic_store_n(&draining, 0, __ATOMIC_RELEASE);
+    return sent && more;
+}
+
+// 由空闲循环在开中断时调用：只送 UART 发送缓冲区放得下的部分，不会同步等待 UART。
+// 返回 1 表示还有剩余，调用者处理完中断和就绪进程后再来；
+// 发送缓冲区满时返回 0，由发送中断腾出空间后唤醒空闲循环
+int log_drain(void) {
+    return drain(uart_tx_room());
+}
+
+// 排空日志并等待 UART 发送完毕
+void log_flush(void) {
+    drain(~0UL);
+    uart_flush();
+}
+
+// 所有 CPU 累计丢弃的日志条数
+uint64 log_dropped(void) {
+    uint64 n = 0;
+    for(int cpu = 0; cpu < NCPU; cpu++)
+        n += log_rings[cpu].dropped;
+    return n;
+}
@@ -0,0 +1,27 @@
+#ifndef _PRINTK_H
+#define _PRINTK_H
+
+#include "types.h"
+#include <stdarg.h>
+
+// 日志级别，数值越小越重要
+#define LOG_ERR   3
+#define LOG_WARN  4
+#define LOG_INFO  6
+#define LOG_DEBUG 7
+
+// 函数声明
+int vsnprintf(char *buf, int size, const char *fmt, va_list ap);
+int snprintf(char *buf, int size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void printk(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void log_set_console_level(int level);
+int log_drain(void);
+void log_flush(void);
+uint64 log_dropped(void);
+
+#define pr_err(...)   printk(LOG_ERR, __VA_ARGS__)
+#define pr_warn(...)  printk(LOG_WARN, __VA_ARGS__)
+#define pr_info(...)  printk(LOG_INFO, __VA_ARGS__)
+#define pr_debug(...) printk(LOG_DEBUG, __VA_ARGS__)
+
+#endif
@@ -1,13 +1,62 @@
 #include "aarch64.h"
+#include "ioring.h"
 #include "proc.h"
-#include "uart.h"
+#include "trap.h"
+#include "printk.h"
+#include "trace.h"
+#include "memlayout.h"
+#include "mm.h"
+#include "pid.h"
+#include "vm.h"
+#include "wait.h"
 
-// 进程表
-static struct proc proc[NPROC];
+// 空闲的进程控制块。控制块按需从整页中切出，释放后留在这里重用，不还给页分配器
+static struct proc *proc_cache;
 // CPU 表
 static struct cpu cpus[NCPU];
 
-int nextpid = 1;
+// 控制台请求的进程信息打印，推迟到空闲循环执行
+static int procdump_requested;
+
+// 进程退出时唤醒 proc_wait 的等待者
+static struct wait_queue exit_wq = WAIT_QUEUE_INIT;
+
+// 内嵌的用户程序，见 userprogs.S
+struct userprog {
+    const char *name;
+    const uint8 *start;
+    const uint8 *end;
+};
+extern struct userprog userprogs[];
+
+// 公平调度：进程运行时按 NICE_0_WEIGHT / weight 的比例累加 vruntime，
+// 总是先运行 vruntime 最小的进程，长期来看各进程得到的 CPU 时间与权重成正比。
+// 就绪队列是按 vruntime 排序的最小堆，只包含 RUNNABLE 进程。
+// 用户态进程在时间片用完或者被唤醒的进程应当先运行时，返回用户态前让出 CPU；
+// 内核线程不被抢占，只在 yield 或阻塞时切换
+static struct proc *runq[PID_MAX];
+static int runq_len;
+static uint64 runq_weight;   // 就绪队列中进程的权重之和
+static uint64 runq_seq;
+// 所有可运行进程 vruntime 的下限，单调增加；新进程和醒来的进程以它为基准
+static uint64 min_vruntime;
+
+// 调度参数（定时器计数），由 proc_init 按定时器频率换算
+static uint64 sched_latency;      // 所有可运行进程各运行一次的目标周期
+static uint64 sched_min_gran;     // 最短时间片
+static uint64 sched_wakeup_gran;  // 醒来的进程领先这么多才抢占当前进程
+
+// nice -20 到 19 对应的权重，相邻两级约差 1.25 倍
+static const uint32 nice_weight[NICE_MAX - NICE_MIN + 1] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15,
+};
 
 // 获取当前 CPU
 struct cpu* mycpu(void) {
@@ -22,60 +71,435 @@ struct proc* myproc(void) {
   return p;
 }
 
-// 申请pid
-int pid_alloc(){
-  return nextpid++;
-}
-
 // 打印进程信息
 static void print_proc_info(struct proc *p) {
     if(!p) return;
-    uart_puts("Process ");
-    uart_putc('0' + p->pid);
-    uart_puts(": state=");
+    const char *state;
     switch(p->state) {
-        case UNUSED: uart_puts("UNUSED"); break;
-        case USED: uart_puts("USED"); break;
-        case RUNNABLE: uart_puts("RUNNABLE"); break;
-        case RUNNING: uart_puts("RUNNING"); break;
-        case BLOCKED : uart_puts("BLOCKED"); break;
-        case ZOMBIE: uart_puts("ZOMBIE"); break;
-        default: uart_puts("UNKNOWN"); break;
+        case UNUSED: state = "UNUSED"; break;
+        case USED: state = "USED"; break;
+        case RUNNABLE: state = "RUNNABLE"; break;
+        case RUNNING: state = "RUNNING"; break;
+        case BLOCKED : state = "BLOCKED"; break;
+        case ZOMBIE: state = "ZOMBIE"; break;
+        default: state = "UNKNOWN"; break;
     }
-    uart_puts("\n");
+    uint64 freq = r_cntfrq();
+    if(p->pagetable)
+        pr_info("Process %lu: state=%s nice=%d cpu=%lu ms vruntime=%lu ms user stack=%lu KB\n",
+                p->pid, state, p->nice, p->cpu_ticks * 1000 / freq, p->vruntime * 1000 / freq,
+                (USER_STACK_TOP - p->stack_low) / 1024);
+    else
+        pr_info("Process %lu: state=%s nice=%d cpu=%lu ms vruntime=%lu ms\n",
+                p->pid, state, p->nice, p->cpu_ticks * 1000 / freq, p->vruntime * 1000 / freq);
+    pmu_print("  pid", p->pid, &p->pmu);
+}
+
+// 打印所有进程的状态和 PMU 统计
+void procdump(void) {
+    for(uint64 pid = pid_next(0); pid; pid = pid_next(pid))
+        print_proc_info(pid_lookup(pid));
+    for(int i = 0; i < NCPU; i++) {
+        pmu_print("cpu", i, &cpus[i].pmu);
+        pr_info("cpu %d 空闲 %lu ms\n", i, cpus[i].idle_ticks * 1000 / r_cntfrq());
+    }
+}
+
+// 由控制台中断调用
+void procdump_request(void) {
+    procdump_requested = 1;
 }
 
 // 初始化进程管理
 void proc_init(void) {
-    for(int i = 0; i < NPROC; i++) {
-        proc[i].state = UNUSED;
-    }
+    pmu_init();
+    fpsimd_init();
+    sched_latency = ns_to_ticks(6000000);
+    sched_min_gran = ns_to_ticks(750000);
+    sched_wakeup_gran = ns_to_ticks(1000000);
     // 初始化当前 CPU 表
     struct cpu *c = mycpu();
     c->proc = 0;
-//    c->noff = 0;
-//    c->intena = 0;
+    c->noff = 0;
+    c->intena = 0;
+    c->idle_ticks = 0;
+    c->need_resched = 0;
     // c->context 会在第一次 switch 时被保存
 }
 
-// 分配一个新的进程控制块
-struct proc* proc_alloc(void) {
-  	struct proc *p;
-    for(int i = 0; i < NPROC; i++) {
-      	p = &proc[i];
-        if(p->state == UNUSED) {
-            p->state = USED;
-            p->pid = pid_alloc();
-            return p;
-        }
+// 从整页中切出一批控制块放进 proc_cache
+static int proc_cache_grow(void) {
+    uint8 *page = alloc_pages(1);
+    if(!page)
+        return -1;
+    for(uint64 off = 0; off + sizeof(struct proc) <= PAGE_SIZE; off += sizeof(struct proc)) {
+        struct proc *p = (struct proc *)(page + off);
+        p->state = UNUSED;
+        p->cache_next = proc_cache;
+        proc_cache = p;
     }
     return 0;
 }
 
-// 释放进程控制块
+// 分配一个新的进程控制块并登记 PID
+struct proc* proc_alloc(void) {
+    push_off();
+    if(!proc_cache && proc_cache_grow() < 0) {
+        pop_off();
+        return 0;
+    }
+    struct proc *p = proc_cache;
+    int pid = pid_alloc(p);
+    if(pid < 0) {
+        pop_off();
+        return 0;
+    }
+    proc_cache = p->cache_next;
+    pop_off();
+
+    p->state = USED;
+    p->pid = pid;
+    p->wait = 0;
+    p->wait_next = 0;
+    memset(&p->pmu, 0, sizeof(p->pmu));
+    p->nice = 0;
+    p->weight = NICE_0_WEIGHT;
+    p->vruntime = min_vruntime;
+    p->cpu_ticks = 0;
+    p->fpsimd_used = 0;
+    p->pagetable = 0;
+    p->asid = 0;
+    p->tf = 0;
+    p->stack_low = 0;
+    memset(p->vma, 0, sizeof(p->vma));
+    p->mmap_top = MMAP_BASE;
+    p->ipc_caller = 0;
+    p->io = 0;
+    return p;
+}
+
+// 释放进程控制块，PID 随之释放
 void proc_free(struct proc *p) {
+    push_off();
+    pid_free(p->pid);
     p->pid = 0;
     p->state = UNUSED;
+    p->cache_next = proc_cache;
+    proc_cache = p;
+    pop_off();
+}
+
+// 按 PID 查找进程，不存在时返回 0
+struct proc* proc_lookup(uint64 pid) {
+    return pid_lookup(pid);
+}
+
+// 创建内核进程：分配进程控制块和内核栈，首次调度时执行 func
+// 返回的进程尚未就绪，由调用者 proc_ready
+struct proc* kthread_create(void (*func)(void)) {
+    struct proc *p = proc_alloc();
+    if(!p)
+        return 0;
+    void *stack = alloc_pages(KSTACK_PAGES);
+    if(!stack) {
+        proc_free(p);
+        return 0;
+    }
+    p->kstack = (uint64)stack + KSTACK_SIZE;
+    memset(&p->context, 0, sizeof(p->context));
+    p->context.sp = p->kstack;
+    p->context.x30 = (uint64)proc_trampoline;
+    p->context.x19 = (uint64)func;
+    return p;
+}
+
+static int streq(const char *a, const char *b) {
+    while(*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+// 释放进程的全部资源，进程不能在运行中
+static void proc_reap(struct proc *p) {
+    fpsimd_release(p);
+    if(p->pagetable)
+        uvm_free(p->pagetable);
+    free_pages((void *)(p->kstack - KSTACK_SIZE), KSTACK_PAGES);
+    proc_free(p);
+}
+
+// 创建用户进程：把内嵌程序 name 装入新的地址空间，在 EL0 从 USER_BASE 开始执行，
+// x0 = arg。返回的进程尚未就绪，由调用者 proc_ready
+struct proc* user_create(const char *name, uint64 arg) {
+    struct userprog *prog = userprogs;
+    while(prog->name && !streq(prog->name, name))
+        prog++;
+    if(!prog->name)
+        return 0;
+
+    struct proc *p = kthread_create(user_start);
+    if(!p)
+        return 0;
+    if((p->pagetable = uvm_create()) == 0)
+        goto bad;
+
+    // 程序是代码和数据连在一起的平坦映像，整体映射为可读写可执行
+    uint64 size = prog->end - prog->start;
+    for(uint64 off = 0; off < size; off += PAGE_SIZE) {
+        uint8 *page = alloc_pages_flags(1, ALLOC_ZERO);
+        if(!page)
+            goto bad;
+        uint64 n = size - off < PAGE_SIZE ? size - off : PAGE_SIZE;
+        memcpy(page, prog->start + off, n);
+        sync_icache(page, n);
+        if(uvm_map(p->pagetable, USER_BASE + off, PAGE_SIZE, V2P(page), UVM_RWX) < 0) {
+            free_pages(page, 1);
+            goto bad;
+        }
+    }
+
+    // 用户栈只预先提交最顶上一页，其余在缺页时分配
+    p->stack_low = USER_STACK_TOP;
+    if(uvm_fault(p, USER_STACK_TOP - PAGE_SIZE, 1) < 0)
+        goto bad;
+
+    // 陷阱帧放在内核栈顶，user_start 从这里返回 EL0；
+    // 之后每次从 EL0 陷入，硬件都会把 sp 放回同一位置
+    p->tf = (struct trapframe *)(p->kstack - sizeof(struct trapframe));
+    memset(p->tf, 0, sizeof(*p->tf));
+    p->tf->elr = USER_BASE;
+    p->tf->sp = USER_STACK_TOP;
+    p->tf->spsr = 0;  // EL0t，中断打开
+    p->tf->x[0] = arg;
+    p->context.sp = (uint64)p->tf;
+    return p;
+
+bad:
+    proc_reap(p);
+    return 0;
+}
+
+// 复制当前用户进程：地址空间写时复制共享，文件映射直接共享，子进程从同一个系统调用返回 0。
+// 返回子进程 pid，失败返回 -1
+int fork(void) {
+    struct proc *p = myproc();
+    struct proc *np = kthread_create(user_start);
+    if(!np)
+        return -1;
+    if((np->pagetable = uvm_create()) == 0 || uvm_copy(p, np) < 0) {
+        proc_reap(np);
+        return -1;
+    }
+    np->stack_low = p->stack_low;
+    memcpy(np->vma, p->vma, sizeof(p->vma));
+    np->mmap_top = p->mmap_top;
+    np->tf = (struct trapframe *)(np->kstack - sizeof(struct trapframe));
+    memcpy(np->tf, p->tf, sizeof(struct trapframe));
+    np->tf->x[0] = 0;
+    np->context.sp = (uint64)np->tf;
+    fpsimd_copy(np, p);
+
+    uint64 pid = np->pid;
+    proc_ready(np);
+    return pid;
+}
+
+// 等待 pid 对应的进程退出
+void proc_wait(uint64 pid) {
+    struct proc *p;
+    // 退出的进程先变成 ZOMBIE，再由调度器回收，之后按 PID 查不到
+    wait_event(&exit_wq, (p = pid_lookup(pid)) == 0 || p->state == ZOMBIE);
+}
+
+// 结束当前进程，资源由调度器在切走之后回收
+void proc_exit(void) {
+    struct proc *p = myproc();
+    // 设备可能还在写这个进程的页，先等异步 I/O 完成
+    ioring_exit(p);
+    push_off();
+    // 正在服务的调用者不会再等到回复
+    if(p->ipc_caller) {
+        p->ipc_caller->ipc_status = -1;
+        proc_ready(p->ipc_caller);
+        p->ipc_caller = 0;
+    }
+    p->state = ZOMBIE;
+    wake_all(&exit_wq);
+    sched();
+    panic("proc_exit: zombie resumed");
+}
+
+// 关中断并记录嵌套深度，与 pop_off 配对使用
+void push_off(void) {
+    int old = intr_get();
+    intr_off();
+    struct cpu *c = mycpu();
+    if(c->noff == 0)
+        c->intena = old;
+    c->noff++;
+}
+
+// 最外层 pop_off 恢复 push_off 之前的中断状态
+void pop_off(void) {
+    struct cpu *c = mycpu();
+    if(intr_get())
+        panic("pop_off: interruptible");
+    if(c->noff < 1)
+        panic("pop_off");
+    c->noff--;
+    if(c->noff == 0 && c->intena)
+        intr_on();
+}
+
+static int runq_before(struct proc *a, struct proc *b) {
+    if(a->vruntime != b->vruntime)
+        return a->vruntime < b->vruntime;
+    return a->rq_seq < b->rq_seq;
+}
+
+static void runq_swap(int i, int j) {
+    struct proc *t = runq[i];
+    runq[i] = runq[j];
+    runq[j] = t;
+}
+
+// 加入就绪队列
+static void runq_push(struct proc *p) {
+    p->rq_seq = runq_seq++;
+    int i = runq_len++;
+    runq[i] = p;
+    runq_weight += p->weight;
+    while(i > 0 && runq_before(runq[i], runq[(i - 1) / 2])) {
+        runq_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+// 取出 vruntime 最小的进程，队列为空时返回 0
+static struct proc* runq_pop(void) {
+    if(runq_len == 0)
+        return 0;
+    struct proc *p = runq[0];
+    runq[0] = runq[--runq_len];
+    runq_weight -= p->weight;
+    int i = 0;
+    for(;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if(l < runq_len && runq_before(runq[l], runq[m]))
+            m = l;
+        if(r < runq_len && runq_before(runq[r], runq[m]))
+            m = r;
+        if(m == i)
+            break;
+        runq_swap(i, m);
+        i = m;
+    }
+    return p;
+}
+
+// 结算 p 自 exec_start 以来的运行时间，并推进 min_vruntime
+static void update_curr(struct proc *p) {
+    uint64 now = r_cntvct();
+    uint64 delta = now - p->exec_start;
+    p->exec_start = now;
+    p->cpu_ticks += delta;
+    p->vruntime += delta * NICE_0_WEIGHT / p->weight;
+
+    uint64 v = p->vruntime;
+    if(runq_len && runq[0]->vruntime < v)
+        v = runq[0]->vruntime;
+    if(v > min_vruntime)
+        min_vruntime = v;
+}
+
+static void slice_expired(struct timer *t) {
+    mycpu()->need_resched = 1;
+}
+
+// 给当前进程 p 一个时间片：按权重分得 sched_latency 的一份，不短于 sched_min_gran。
+// 没有其他可运行进程时不设定时器
+static void slice_start(struct cpu *c, struct proc *p) {
+    if(runq_len == 0 || c->slice_timer.pending)
+        return;
+    uint64 slice = sched_latency * p->weight / (p->weight + runq_weight);
+    if(slice < sched_min_gran)
+        slice = sched_min_gran;
+    timer_add(&c->slice_timer, r_cntvct() + slice, slice_expired);
+}
+
+// 标记进程可运行并加入就绪队列，可在中断处理中调用
+void proc_ready(struct proc *p) {
+    push_off();
+    struct cpu *c = mycpu();
+    // 醒来的进程 vruntime 不低于 min_vruntime 减去半个周期：
+    // 睡得久的进程不会凭落后的 vruntime 长期独占 CPU，刚醒来时又能优先运行
+    uint64 floor = min_vruntime > sched_latency / 2 ? min_vruntime - sched_latency / 2 : 0;
+    if(p->vruntime < floor)
+        p->vruntime = floor;
+    p->state = RUNNABLE;
+    runq_push(p);
+
+    struct proc *curr = c->proc;
+    if(curr && curr->state == RUNNING) {
+        update_curr(curr);
+        if(p->vruntime + sched_wakeup_gran < curr->vruntime)
+            c->need_resched = 1;
+        else
+            slice_start(c, curr);
+    }
+    pop_off();
+}
+
+// 设置 nice 值，p 不能在就绪队列中
+void proc_set_nice(struct proc *p, int nice) {
+    if(nice < NICE_MIN)
+        nice = NICE_MIN;
+    if(nice > NICE_MAX)
+        nice = NICE_MAX;
+    p->nice = nice;
+    p->weight = nice_weight[nice - NICE_MIN];
+}
+
+// 进程 pid 累计的 CPU 时间（纳秒），进程不存在时返回 0
+uint64 proc_cputime(uint64 pid) {
+    uint64 t = 0;
+    push_off();
+    struct proc *p = pid_lookup(pid);
+    if(p) {
+        if(p->state == RUNNING)
+            update_curr(p);
+        t = p->cpu_ticks;
+    }
+    pop_off();
+    return t * 1000000000 / r_cntfrq();
+}
+
+// 切入 next 前的准备：状态、PMU 计数起点、运行时间起点、时间片和 FP 访问权限
+// 调度器和 yield 的直接切换共用
+static void switch_in(struct cpu *c, struct proc *next) {
+    next->state = RUNNING;
+    c->proc = next;
+    c->need_resched = 0;
+    pmu_read(&c->pmu_start);
+    next->exec_start = r_cntvct();
+    slice_start(c, next);
+    fpsimd_switch(next);
+    vm_switch(next->pagetable, &next->asid);
+}
+
+// 结算切出的进程 p：PMU 计数、运行时间，并取消它的时间片
+static void switch_out(struct cpu *c, struct proc *p) {
+    pmu_account(&p->pmu, &c->pmu, &c->pmu_start);
+    update_curr(p);
+    timer_cancel(&c->slice_timer);
+}
+
+// 返回用户态前调用：需要时让出 CPU
+void preempt_user(void) {
+    if(mycpu()->need_resched)
+        yield();
 }
 
 // 进程调度器
@@ -85,35 +509,128 @@ void scheduler(void) {
 
     struct proc *p;
     for(;;) {
-        // 避免死锁，确保设备可以中断 (如果实现中断，取消注释)
-        // intr_on();
-
-        for(int i = 0; i < NPROC; i++) {
-         	p = &proc[i];
-        	if(p->state == RUNNABLE) {
-            	p->state = RUNNING;
-            	c->proc = p;
-            	// 切换到下一进程，当该进程 yield 后，cpu会回到这里
-            	switch_context(&c->context, &p->context);
-            	// 进程返回时，c->proc 仍然指向刚刚运行的进程。
-            	// 调度器将继续循环，从 ready_queue 中获取下一个进程。
-            	// 此时将 c->proc 重置为 0，以便在下一次循环中正确设置。
-            	c->proc = 0;
-          	}
+        // 避免死锁，确保设备可以中断
+        intr_on();
+
+        push_off();
+        while((p = runq_pop()) != 0) {
+            trace(TRACE_SCHED_SWITCH, 0, p->pid);
+            switch_in(c, p);
+            // 切换到下一进程，当某个进程阻塞或退出后，cpu会回到这里
+            switch_context(&c->context, &p->context);
+            // 进程之间可能已经直接切换过，回来的不一定是 p
+            p = c->proc;
+            // 把这段运行期间的计数和时间记到进程和 CPU 上
+            switch_out(c, p);
+            // 已退出的进程不再使用自己的栈，可以安全释放
+            if(p->state == ZOMBIE) {
+                // TTBR0 可能仍指向它的页表
+                vm_switch(0, 0);
+                proc_reap(p);
+            }
+            // 进程返回时，c->proc 仍然指向刚刚运行的进程，重置为 0
+            c->proc = 0;
+        }
+        pop_off();
+
+        // 没有可运行进程时开着中断把日志送到控制台。每次只送发送缓冲区放得下的部分，
+        // 还有剩余就回到循环开头，先处理中断和新就绪的进程，与 mm_zero_fill 每次清一页相同
+        // Ctrl-T 请求的跟踪转储同样分批输出
+        if(log_drain() || trace_poll())
+            continue;
+
+        push_off();
+        if(procdump_requested) {
+            procdump_requested = 0;
+            procdump();
         }
+        // 仍在关中断下确认没有可运行进程后执行 WFI；此后到来的中断保持挂起，
+        // 使 WFI 立即返回，不会错过唤醒。中断在循环开头打开后处理。
+        // 零页池未满时先补池，每清一页就回到循环开头处理中断和新就绪的进程
+        if(runq_len == 0 && !mm_zero_fill()) {
+            uint64 t0 = r_cntvct();
+            asm volatile("dsb sy; wfi" ::: "memory");
+            c->idle_ticks += r_cntvct() - t0;
+        }
+        pop_off();
     }
 }
 
+// 切换回调度器上下文，调用者必须已 push_off 恰好一次
+void sched(void) {
+    struct proc *p = myproc();
+    struct cpu *c = mycpu();
+
+    if(c->noff != 1)
+        panic("sched: noff");
+    if(p->state == RUNNING)
+        panic("sched: running");
+
+    // intena 属于当前进程而不是 CPU，跨切换保存
+    int intena = c->intena;
+    trace(TRACE_SCHED_SWITCH, p->pid, 0);
+    switch_context(&p->context, &c->context);
+    mycpu()->intena = intena;
+}
+
 // 主动让出CPU
+// 有其他可运行进程时直接切换到 vruntime 最小的一个，不经过调度器上下文，
+// 一次让出只需一次 switch_context；没有时继续运行当前进程
 void yield(void) {
     struct proc *p = myproc();
+    struct cpu *c = mycpu();
+    push_off();
+    if(c->noff != 1)
+        panic("yield: noff");
+
+    struct proc *next = runq_pop();
+    if(next == 0) {
+        c->need_resched = 0;
+        pop_off();
+        return;
+    }
+    // 结算当前进程的计数和运行时间，按新的 vruntime 放回就绪队列，再切入下一进程
+    switch_out(c, p);
     p->state = RUNNABLE;
+    runq_push(p);
+    trace(TRACE_SCHED_SWITCH, p->pid, next->pid);
+    switch_in(c, next);
 
-    // 将当前进程的上下文保存到其 proc 结构中，
-    // 然后切换到 CPU 的调度器上下文。
-    // 这将使执行流返回到 scheduler() 函数中的 switch_context 调用点。
-    switch_context(&p->context, &mycpu()->context);
+    // intena 属于当前进程而不是 CPU，跨切换保存
+    int intena = c->intena;
+    switch_context(&p->context, &next->context);
+    mycpu()->intena = intena;
+    pop_off();
 }
 
-// 汇编实现的上下文切换
-extern void switch_context(struct context *old, struct context *new);
\ No newline at end of file
+// 把 CPU 直接交给阻塞中的 next，不经过就绪队列和调度器上下文，用于同步调用。
+// 调用者必须已 push_off 恰好一次，并已把当前进程设为阻塞。
+// 时间片不重新开始，next 接着用当前进程剩下的时间片；运行时间仍记在各自名下
+void proc_handoff(struct proc *next) {
+    struct proc *p = myproc();
+    struct cpu *c = mycpu();
+    if(c->noff != 1)
+        panic("proc_handoff: noff");
+
+    pmu_account(&p->pmu, &c->pmu, &c->pmu_start);
+    update_curr(p);
+    trace(TRACE_SCHED_SWITCH, p->pid, next->pid);
+    next->state = RUNNING;
+    c->proc = next;
+    pmu_read(&c->pmu_start);
+    next->exec_start = r_cntvct();
+    fpsimd_switch(next);
+    vm_switch(next->pagetable, &next->asid);
+
+    // intena 属于当前进程而不是 CPU，跨切换保存
+    int intena = c->intena;
+    switch_context(&p->context, &next->context);
+    mycpu()->intena = intena;
+}
+
+// 新进程第一次被调度时由 proc_trampoline 调用，
+// 结束调度器或 yield 中的 push_off，新进程总是开中断运行
+void forkret(void) {
+    mycpu()->intena = 1;
+    pop_off();
+}
@@ -2,12 +2,24 @@
 #define _PROC_H
 
 #include "types.h"
+#include "wait.h"
+#include "pmu.h"
+#include "fpsimd.h"
+#include "vm.h"
+#include "timer.h"
+#include "pid.h"
 
 // CPU数
 #define NCPU 1
 
-// 最大进程数
-#define NPROC 16
+// nice 值范围，0 为默认，越小权重越大
+#define NICE_MIN (-20)
+#define NICE_MAX 19
+#define NICE_0_WEIGHT 1024
+
+// 每个进程的内核栈大小
+#define KSTACK_PAGES 4
+#define KSTACK_SIZE (KSTACK_PAGES * 4096)
 
 // 进程上下文结构
 struct context {
@@ -27,6 +39,8 @@ struct context {
     uint64 x30;    // 链接寄存器
 };
 
+struct io_ctx;
+
 // 进程状态枚举
 enum procstate { UNUSED, USED, BLOCKED, RUNNABLE, RUNNING, ZOMBIE };
 
@@ -35,6 +49,27 @@ struct proc {
     uint64 state;        // 进程状态
     uint64 pid;          // 进程ID
     uint64 kstack;      // 内核栈指针
+    struct proc *cache_next;      // 空闲控制块链接
+    uint64 rq_seq;                // 入队序号，vruntime 相同时先入队的先运行
+    int nice;                     // nice 值
+    uint64 weight;                // nice 对应的权重
+    uint64 vruntime;              // 按权重折算的虚拟运行时间（定时器计数）
+    uint64 exec_start;            // 本次开始运行或上次结算的时刻
+    uint64 cpu_ticks;             // 累计运行时间（定时器计数）
+    struct wait_queue *wait;      // 阻塞所在的等待队列
+    struct proc *wait_next;       // 等待队列链接
+    struct pmu_counts pmu;        // 累计的 PMU 计数
+    int fpsimd_used;              // 是否使用过 FP/SIMD
+    struct fpsimd_state fpsimd;   // 不持有 FP 寄存器时保存的 FP/SIMD 状态
+    pagetable_t pagetable;        // 用户页表，内核线程为 0
+    uint64 asid;                  // 地址空间的 ASID（含分配时的代）
+    struct trapframe *tf;         // 用户进程内核栈顶的陷阱帧
+    uint64 stack_low;             // 用户栈已分配的最低地址（最高水位）
+    struct vma vma[NVMA];         // 文件映射区
+    uint64 mmap_top;              // 下一个文件映射的起始地址
+    struct proc *ipc_caller;      // 同步调用中正在服务的调用者
+    int ipc_status;               // 同步调用的结果，由回复方填写
+    struct io_ctx *io;            // 异步 I/O 环，见 ioring.c
     struct context context; // 进程上下文
 };
 
@@ -42,8 +77,13 @@ struct proc {
 struct cpu {
     struct proc *proc;          // 当前运行的进程
     struct context context;     // CPU 的上下文
-//    int noff;                   // 中断嵌套深度
-//    int intena;                 // 中断使能状态
+    int noff;                   // 中断嵌套深度
+    int intena;                 // 中断使能状态
+    struct pmu_counts pmu;      // 本 CPU 上所有进程累计的 PMU 计数
+    struct pmu_counts pmu_start; // 当前进程切入时的计数快照
+    uint64 idle_ticks;          // 在 WFI 中度过的定时器计数
+    struct timer slice_timer;   // 当前进程的时间片
+    int need_resched;           // 返回用户态前应当让出 CPU
 };
 
 // 函数声明
@@ -52,10 +92,30 @@ struct proc* myproc(void);
 void proc_init(void);
 struct proc* proc_alloc(void);
 void proc_free(struct proc *p);
+struct proc* proc_lookup(uint64 pid);
 void scheduler(void);
 void yield(void);
+void preempt_user(void);
+void proc_set_nice(struct proc *p, int nice);
+uint64 proc_cputime(uint64 pid);
+void sched(void);
+void proc_handoff(struct proc *next);
+void proc_ready(struct proc *p);
+void procdump(void);
+struct proc* kthread_create(void (*func)(void));
+struct proc* user_create(const char *name, uint64 arg);
+int fork(void);
+void proc_wait(uint64 pid);
+void proc_exit(void) __attribute__((noreturn));
+void procdump_request(void);
+void push_off(void);
+void pop_off(void);
 
 // 汇编实现的上下文切换
 extern void switch_context(struct context *old, struct context *new);
+// 新进程首次运行的入口，x19 保存进程函数，函数返回后进入 proc_exit
+extern void proc_trampoline(void);
+// 用户进程首次运行的入口，从陷阱帧返回 EL0
+extern void user_start(void);
 
 #endif
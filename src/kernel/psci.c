@@ -0,0 +1,24 @@
+#include "psci.h"
+#include "printk.h"
+
+// QEMU virt 在没有 EL2/EL3 时由 HVC 调用提供 PSCI
+static uint64 psci_call(uint64 fn, uint64 a0, uint64 a1, uint64 a2) {
+    register uint64 x0 asm("x0") = fn;
+    register uint64 x1 asm("x1") = a0;
+    register uint64 x2 asm("x2") = a1;
+    register uint64 x3 asm("x3") = a2;
+    asm volatile("hvc #0"
+                 : "+r" (x0)
+                 : "r" (x1), "r" (x2), "r" (x3)
+                 : "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11",
+                   "x12", "x13", "x14", "x15", "x16", "x17", "memory");
+    return x0;
+}
+
+// 关闭整个系统，QEMU 随之退出
+void psci_system_off(void) {
+    log_flush();
+    psci_call(PSCI_SYSTEM_OFF, 0, 0, 0);
+    for(;;)
+        asm volatile("wfe");
+}
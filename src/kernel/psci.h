@@ -0,0 +1,12 @@
+#ifndef _PSCI_H
+#define _PSCI_H
+
+#include "types.h"
+
+// PSCI 0.2 函数编号
+#define PSCI_SYSTEM_OFF 0x84000008
+
+// 函数声明
+void psci_system_off(void) __attribute__((noreturn));
+
+#endif
@@ -0,0 +1,46 @@
+#include "ramdisk.h"
+#include "blk.h"
+#include "mm.h"
+#include "printk.h"
+#include "vm.h"
+
+// 内存盘 "ram0"：数据放在一段连续的物理页里，提交时直接拷贝并完成，
+// 用来在没有 virtio 开销的情况下测文件系统和块层本身
+static struct blk_dev ram0;
+static uint8 *ram_data;
+
+static int ramdisk_submit(struct blk_dev *d, struct blk_req *r) {
+    int status = 0;
+    if(r->op != BLK_FLUSH) {
+        if((uint64)r->start + r->total > d->nsectors) {
+            status = -1;
+        } else {
+            uint8 *p = ram_data + (uint64)r->start * 512;
+            for(struct blk_req *s = r->first; s; s = s->seg) {
+                if(r->op == BLK_WRITE)
+                    memcpy(p, s->buf, s->nsect * 512);
+                else
+                    memcpy(s->buf, p, s->nsect * 512);
+                p += s->nsect * 512;
+            }
+        }
+    }
+    blk_end(d, r, status);
+    return 0;
+}
+
+// 建立 nsectors 个扇区的内存盘并注册为 "ram0"，已经建立过时返回原来的设备
+struct blk_dev *ramdisk_create(uint64 nsectors) {
+    if(ram_data)
+        return &ram0;
+    ram_data = alloc_pages_flags((nsectors * 512 + PAGE_SIZE - 1) / PAGE_SIZE, ALLOC_ZERO);
+    if(!ram_data) {
+        pr_err("ramdisk: no memory for %d sectors\n", (int)nsectors);
+        return 0;
+    }
+    ram0.name = "ram0";
+    ram0.nsectors = nsectors;
+    ram0.submit = ramdisk_submit;
+    blk_register(&ram0, "noop");
+    return &ram0;
+}
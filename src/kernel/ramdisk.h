@@ -0,0 +1,11 @@
+#ifndef _RAMDISK_H
+#define _RAMDISK_H
+
+#include "types.h"
+
+struct blk_dev;
+
+// 函数声明
+struct blk_dev *ramdisk_create(uint64 nsectors);
+
+#endif
@@ -0,0 +1,175 @@
+#include "syscall.h"
+#include "fat.h"
+#include "ioring.h"
+#include "ipc.h"
+#include "printk.h"
+#include "proc.h"
+#include "timer.h"
+#include "trap.h"
+#include "uart.h"
+#include "vm.h"
+
+// void exit(void)
+static uint64 sys_exit(struct trapframe *tf) {
+    proc_exit();
+}
+
+// int write(const char *buf, int len)：输出到控制台，返回写出的字节数
+static uint64 sys_write(struct trapframe *tf) {
+    struct proc *p = myproc();
+    uint64 va = tf->x[0];
+    uint64 len = tf->x[1];
+    char buf[128];
+    for(uint64 done = 0; done < len; ) {
+        uint64 n = len - done;
+        if(n > sizeof(buf))
+            n = sizeof(buf);
+        if(copyin(p, buf, va + done, n) < 0)
+            return -1;
+        for(uint64 i = 0; i < n; i++)
+            uart_putc(buf[i]);
+        done += n;
+    }
+    return len;
+}
+
+// void yield(void)
+static uint64 sys_yield(struct trapframe *tf) {
+    yield();
+    return 0;
+}
+
+// int getpid(void)
+static uint64 sys_getpid(struct trapframe *tf) {
+    return myproc()->pid;
+}
+
+// int fork(void)：父进程返回子进程 pid，子进程返回 0
+static uint64 sys_fork(struct trapframe *tf) {
+    return fork();
+}
+
+// void wait(int pid)：等待进程退出
+static uint64 sys_wait(struct trapframe *tf) {
+    proc_wait(tf->x[0]);
+    return 0;
+}
+
+// void *mmap(const char *name, uint64 offset, uint64 len, int prot)：
+// 映射 FAT 根目录下的文件（11 字节 8.3 名），offset 须按页对齐，失败返回 0
+static uint64 sys_mmap(struct trapframe *tf) {
+    struct proc *p = myproc();
+    char name[11];
+    uint64 offset = tf->x[1];
+    if(copyin(p, name, tf->x[0], sizeof(name)) < 0 || (offset & (PAGE_SIZE - 1)))
+        return 0;
+    if(fat_file_size(name) < 0)
+        return 0;
+    return uvm_mmap(p, name, offset / PAGE_SIZE, tf->x[2], (tf->x[3] & PROT_WRITE) != 0);
+}
+
+// int msync(void *addr, uint64 len)：把映射中修改过的页写回文件
+static uint64 sys_msync(struct trapframe *tf) {
+    return uvm_msync(myproc(), tf->x[0], tf->x[1]);
+}
+
+// int ipc_create(void)：新建 IPC 通道，返回通道 id，失败返回 -1
+static uint64 sys_ipc_create(struct trapframe *tf) {
+    return chan_create();
+}
+
+// int ipc_close(int id)
+static uint64 sys_ipc_close(struct trapframe *tf) {
+    return chan_close(tf->x[0]);
+}
+
+// struct ipc_shared *ipc_map(int id)：映射通道的共享页，失败返回 0
+static uint64 sys_ipc_map(struct trapframe *tf) {
+    return chan_map(myproc(), tf->x[0]);
+}
+
+// int ipc_wait(int id, int ring, int what)：睡眠直到环中有消息或有空槽
+static uint64 sys_ipc_wait(struct trapframe *tf) {
+    return chan_wait(tf->x[0], tf->x[1], tf->x[2]);
+}
+
+// int ipc_notify(int id, int ring)：唤醒在环上等待的进程
+static uint64 sys_ipc_notify(struct trapframe *tf) {
+    return chan_notify(tf->x[0], tf->x[1]);
+}
+
+// int ipc_give(int id, int ring, void *buf, uint64 len)：把缓冲区中的页转给环的接收方
+static uint64 sys_ipc_give(struct trapframe *tf) {
+    return chan_give(myproc(), tf->x[0], tf->x[1], tf->x[2], tf->x[3]);
+}
+
+// int ipc_take(int id, int ring, void *buf)：把收到的页映射到缓冲区，返回字节数
+static uint64 sys_ipc_take(struct trapframe *tf) {
+    return chan_take(myproc(), tf->x[0], tf->x[1], tf->x[2]);
+}
+
+// int ep_create(void)：新建同步调用端点，返回端点 id，失败返回 -1
+static uint64 sys_ep_create(struct trapframe *tf) {
+    return ep_create();
+}
+
+// int call(int ep, struct ipc_msg *m)：消息在 x2-x5 中传递，回复写回同样的寄存器，见 usys.S
+static uint64 sys_call(struct trapframe *tf) {
+    return ep_call(myproc(), tf->x[0]);
+}
+
+// int reply_wait(int ep, struct ipc_msg *m)：回复上一个调用者并等待下一次调用，返回调用者 pid
+static uint64 sys_reply_wait(struct trapframe *tf) {
+    return ep_reply_wait(myproc(), tf->x[0]);
+}
+
+// struct io_rings *io_setup(void)：建立本进程的异步 I/O 环，失败返回 0
+static uint64 sys_io_setup(struct trapframe *tf) {
+    return ioring_setup(myproc());
+}
+
+// int io_enter(uint32 to_submit, uint32 min_complete)：提交 SQE 并等待完成，返回提交的个数
+static uint64 sys_io_enter(struct trapframe *tf) {
+    return ioring_enter(myproc(), tf->x[0], tf->x[1]);
+}
+
+// void sleep_ns(uint64 ns)：睡眠 ns 纳秒
+static uint64 sys_sleep(struct trapframe *tf) {
+    sleep_ns(tf->x[0]);
+    return 0;
+}
+
+static uint64 (*syscalls[])(struct trapframe *) = {
+    [SYS_exit]   = sys_exit,
+    [SYS_write]  = sys_write,
+    [SYS_yield]  = sys_yield,
+    [SYS_getpid] = sys_getpid,
+    [SYS_fork]   = sys_fork,
+    [SYS_wait]   = sys_wait,
+    [SYS_mmap]   = sys_mmap,
+    [SYS_msync]  = sys_msync,
+    [SYS_ipc_create] = sys_ipc_create,
+    [SYS_ipc_close]  = sys_ipc_close,
+    [SYS_ipc_map]    = sys_ipc_map,
+    [SYS_ipc_wait]   = sys_ipc_wait,
+    [SYS_ipc_notify] = sys_ipc_notify,
+    [SYS_ipc_give]   = sys_ipc_give,
+    [SYS_ipc_take]   = sys_ipc_take,
+    [SYS_ep_create]  = sys_ep_create,
+    [SYS_call]       = sys_call,
+    [SYS_reply_wait] = sys_reply_wait,
+    [SYS_io_setup]   = sys_io_setup,
+    [SYS_io_enter]   = sys_io_enter,
+    [SYS_sleep]      = sys_sleep,
+};
+
+// 按 x8 分发系统调用，返回值写回 x0
+void syscall(struct trapframe *tf) {
+    uint64 num = tf->x[8];
+    if(num < sizeof(syscalls) / sizeof(syscalls[0]) && syscalls[num]) {
+        tf->x[0] = syscalls[num](tf);
+    } else {
+        pr_err("pid %lu: 未知系统调用 %lu\n", myproc()->pid, num);
+        tf->x[0] = -1;
+    }
+}
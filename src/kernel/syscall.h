@@ -0,0 +1,39 @@
+#ifndef _SYSCALL_H
+#define _SYSCALL_H
+
+// 系统调用号：x8 传调用号，x0-x5 传参数，返回值放在 x0
+// 用户程序（src/user）也包含这个头文件
+#define SYS_exit    1
+#define SYS_write   2
+#define SYS_yield   3
+#define SYS_getpid  4
+#define SYS_fork    5
+#define SYS_wait    6
+#define SYS_mmap    7
+#define SYS_msync   8
+#define SYS_ipc_create 9
+#define SYS_ipc_close  10
+#define SYS_ipc_map    11
+#define SYS_ipc_wait   12
+#define SYS_ipc_notify 13
+#define SYS_ipc_give   14
+#define SYS_ipc_take   15
+#define SYS_ep_create  16
+#define SYS_call       17
+#define SYS_reply_wait 18
+#define SYS_io_setup   19
+#define SYS_io_enter   20
+#define SYS_sleep      21
+
+// mmap 的 prot 参数
+#define PROT_READ   1
+#define PROT_WRITE  2
+
+#ifndef __ASSEMBLER__
+struct trapframe;
+
+// 函数声明
+void syscall(struct trapframe *tf);
+#endif
+
+#endif
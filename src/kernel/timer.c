@@ -0,0 +1,213 @@
+#include "timer.h"
+#include "aarch64.h"
+#include "gic.h"
+#include "memlayout.h"
+#include "proc.h"
+
+// 无周期时钟节拍：只有存在定时事件时，才把最早的到期时间写入虚拟定时器的比较寄存器，
+// 没有定时事件时关闭定时器，空闲的 CPU 一直停在 WFI 里，直到设备中断或定时事件到期。
+//
+// 定时事件放在分层时间轮里，加入和取消都是 O(1)。时间以第 0 层的槽宽为单位，clk 是时间轮走到的单位，
+// 不超过当前时间所在的单位。到期单位 e 与 clk 相差不到 64 时放在第 0 层的槽 e % 64；否则放在能容纳
+// 这个差值的最低一层 k，槽号是 (e >> 6k) % 64，等 clk 走到这个槽的起点时再按剩余时间分散到下面几层（级联）。
+// 每层有一个非空槽的位图，下一个要处理的单位（第 0 层的非空槽或高层的级联点）只需每层一次 ctz，
+// 中断直接跳到那里，不逐个单位推进，也不扫描定时事件
+
+#define CNTV_CTL_ENABLE (1 << 0)
+#define TIMER_MASK (TIMER_SLOTS - 1)
+#define TIMER_NONE (~0UL)
+
+static struct {
+    uint64 clk;
+    uint64 count;                                  // 轮中的定时事件数
+    uint64 bitmap[TIMER_LEVELS];                   // 非空槽
+    struct timer *slot[TIMER_LEVELS][TIMER_SLOTS];
+} wheel;
+
+// 把 t 挂进时间轮，调用者需关中断
+static void wheel_insert(struct timer *t) {
+    uint64 e = t->deadline >> TIMER_SHIFT;
+    if(e < wheel.clk)
+        e = wheel.clk;
+    uint64 delta = e - wheel.clk;
+    int lvl = 0;
+    while(lvl < TIMER_LEVELS - 1 && delta >= (uint64)TIMER_SLOTS << (lvl * TIMER_BITS))
+        lvl++;
+    // 超出最高层范围的先放在最高层最远的槽，级联时按真实的到期时间重新放
+    if(delta >= (uint64)TIMER_SLOTS << (lvl * TIMER_BITS))
+        e = wheel.clk + ((uint64)TIMER_SLOTS << (lvl * TIMER_BITS)) - 1;
+    uint32 idx = (e >> (lvl * TIMER_BITS)) & TIMER_MASK;
+    struct timer **head = &wheel.slot[lvl][idx];
+    t->slot = lvl * TIMER_SLOTS + idx;
+    t->next = *head;
+    if(*head)
+        (*head)->pprev = &t->next;
+    t->pprev = head;
+    *head = t;
+    wheel.bitmap[lvl] |= 1UL << idx;
+    wheel.count++;
+}
+
+// 从时间轮摘下 t，调用者需关中断
+static void wheel_remove(struct timer *t) {
+    *t->pprev = t->next;
+    if(t->next)
+        t->next->pprev = t->pprev;
+    uint32 lvl = t->slot / TIMER_SLOTS, idx = t->slot % TIMER_SLOTS;
+    if(!wheel.slot[lvl][idx])
+        wheel.bitmap[lvl] &= ~(1UL << idx);
+    wheel.count--;
+}
+
+// 下一个要处理的单位：第 0 层最近的非空槽，或者高层最近的非空槽的级联点，取较早者。
+// 第 0 层的槽更早时 *lvl0 置 1。没有定时事件时返回 TIMER_NONE
+static uint64 wheel_next(int *lvl0) {
+    uint64 next = TIMER_NONE;
+    *lvl0 = 0;
+    for(int lvl = 0; lvl < TIMER_LEVELS; lvl++) {
+        uint64 bm = wheel.bitmap[lvl];
+        if(!bm)
+            continue;
+        int shift = lvl * TIMER_BITS;
+        // 第 0 层的槽从 clk 所在的槽数起；高层的定时事件总在 clk 所在块之后级联
+        uint64 base = lvl == 0 ? wheel.clk : (wheel.clk >> shift) + 1;
+        uint32 rot = base & TIMER_MASK;
+        uint64 r = rot ? (bm >> rot) | (bm << (TIMER_SLOTS - rot)) : bm;
+        uint64 u = (base + __builtin_ctzl(r)) << shift;
+        // 同一单位既有级联又有到期时按级联算，级联下来的事件可能更早到期
+        if(u < next || (u == next && lvl > 0)) {
+            next = u;
+            *lvl0 = lvl == 0;
+        }
+    }
+    return next;
+}
+
+// 按最近的事件重新设置比较值，调用者需关中断。下一个是第 0 层的槽时取槽内最早的到期时间，
+// 是级联点时在级联点中断一次
+static void timer_program(void) {
+    int lvl0;
+    uint64 u = wheel_next(&lvl0);
+    if(u == TIMER_NONE) {
+        asm volatile("msr cntv_ctl_el0, xzr; isb");
+        return;
+    }
+    uint64 when = u << TIMER_SHIFT;
+    if(lvl0) {
+        when = TIMER_NONE;
+        for(struct timer *t = wheel.slot[0][u & TIMER_MASK]; t; t = t->next)
+            if(t->deadline < when)
+                when = t->deadline;
+    }
+    asm volatile("msr cntv_cval_el0, %0; msr cntv_ctl_el0, %1; isb"
+                 : : "r" (when), "r" ((uint64)CNTV_CTL_ENABLE));
+}
+
+// clk 走到块的起点时，把高层对应槽里的定时事件按剩余时间重新放到下面几层
+static void wheel_cascade(void) {
+    for(int lvl = 1; lvl < TIMER_LEVELS; lvl++) {
+        uint32 idx = (wheel.clk >> (lvl * TIMER_BITS)) & TIMER_MASK;
+        struct timer *t = wheel.slot[lvl][idx];
+        wheel.slot[lvl][idx] = 0;
+        wheel.bitmap[lvl] &= ~(1UL << idx);
+        while(t) {
+            struct timer *next = t->next;
+            wheel.count--;
+            wheel_insert(t);
+            t = next;
+        }
+        if(idx != 0)
+            break;
+    }
+}
+
+// 执行 clk 所在第 0 层槽中到期的事件，回调可能加入或取消定时事件，每执行一个都从槽头重新找。
+// 返回槽中剩下的（尚未到期的）事件是否为空
+static int wheel_expire(uint64 now) {
+    struct timer **head = &wheel.slot[0][wheel.clk & TIMER_MASK];
+    struct timer *t = *head;
+    while(t) {
+        if(t->deadline > now) {
+            t = t->next;
+            continue;
+        }
+        wheel_remove(t);
+        t->pending = 0;
+        t->fn(t);
+        t = *head;
+    }
+    return *head == 0;
+}
+
+void timer_init(void) {
+    wheel.clk = r_cntvct() >> TIMER_SHIFT;
+    timer_program();
+    gic_enable_irq(TIMER_IRQ);
+}
+
+// 加入定时事件，deadline 已过时在下一次中断里立即到期
+void timer_add(struct timer *t, uint64 deadline, void (*fn)(struct timer *)) {
+    push_off();
+    // 轮空时 clk 可能已经落后很久，直接拨到现在，免得中断一路级联追上来
+    if(wheel.count == 0)
+        wheel.clk = r_cntvct() >> TIMER_SHIFT;
+    t->deadline = deadline;
+    t->fn = fn;
+    wheel_insert(t);
+    t->pending = 1;
+    timer_program();
+    pop_off();
+}
+
+// 取消尚未到期的定时事件
+void timer_cancel(struct timer *t) {
+    push_off();
+    if(t->pending) {
+        wheel_remove(t);
+        t->pending = 0;
+        timer_program();
+    }
+    pop_off();
+}
+
+// 定时器中断：从 clk 跳到下一个要处理的单位，级联、执行到期的事件，直到追上当前时间；
+// 再按剩下的最早事件重新设置，或者关闭定时器
+void timerintr(void) {
+    uint64 now = r_cntvct();
+    int lvl0;
+    for(;;) {
+        uint64 u = wheel_next(&lvl0);
+        if(u == TIMER_NONE || u > now >> TIMER_SHIFT)
+            break;
+        wheel.clk = u;
+        if((u & TIMER_MASK) == 0)
+            wheel_cascade();
+        // 当前单位里还有没到期的事件时停在这个单位，下次中断继续。clk 不越过当前时间所在的单位，
+        // 之后加入的已过期事件放在 clk 的槽里，仍会在下一次中断里处理
+        if(!wheel_expire(now) || u == now >> TIMER_SHIFT)
+            break;
+        wheel.clk = u + 1;
+    }
+    timer_program();
+}
+
+// 纳秒换算成定时器计数，分开整秒和余数避免溢出
+uint64 ns_to_ticks(uint64 ns) {
+    uint64 freq = r_cntfrq();
+    return ns / 1000000000 * freq + ns % 1000000000 * freq / 1000000000;
+}
+
+// 当前进程睡眠 ns 纳秒
+void sleep_ns(uint64 ns) {
+    struct wait_queue wq = WAIT_QUEUE_INIT;
+    uint64 deadline = r_cntvct() + ns_to_ticks(ns);
+    push_off();
+    // 没有人会唤醒 wq，只在超时时返回
+    while(wait_sleep_until(&wq, deadline) == 0)
+        ;
+    pop_off();
+}
+
+void sleep_ms(uint64 ms) {
+    sleep_ns(ms * 1000000);
+}
@@ -0,0 +1,32 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+
+// 单次定时事件，到期时在中断上下文中调用 fn
+struct timer {
+    uint64 deadline;            // 到期时的 CNTVCT_EL0 计数
+    void (*fn)(struct timer *t);
+    struct timer *next;         // 时间轮槽内的链表
+    struct timer **pprev;       // 指向前一个节点的 next（或槽头），取消时不必遍历
+    uint32 slot;                // 所在的槽：层号 * TIMER_SLOTS + 槽号
+    int pending;                // 已加入、尚未到期
+};
+
+// 时间轮：TIMER_LEVELS 层，每层 TIMER_SLOTS 个槽。第 0 层一个槽是 2^TIMER_SHIFT 个定时器计数
+// （62.5MHz 下约 1us），往上每层的槽宽是下一层的 TIMER_SLOTS 倍
+#define TIMER_SHIFT  6
+#define TIMER_BITS   6
+#define TIMER_SLOTS  (1 << TIMER_BITS)
+#define TIMER_LEVELS 6
+
+// 函数声明
+void timer_init(void);
+void timer_add(struct timer *t, uint64 deadline, void (*fn)(struct timer *));
+void timer_cancel(struct timer *t);
+void timerintr(void);
+uint64 ns_to_ticks(uint64 ns);
+void sleep_ns(uint64 ns);
+void sleep_ms(uint64 ms);
+
+#endif
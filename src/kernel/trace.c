@@ -0,0 +1,100 @@
+#include "trace.h"
+#include "aarch64.h"
+#include "printk.h"
+#include "proc.h"
+#include "uart.h"
+
+#ifdef CONFIG_TRACE
+
+// 事件缓冲区容量，必须是2的幂；写满后覆盖最旧的事件
+#define TRACE_NEVENTS 8192
+
+static struct trace_event trace_buf[TRACE_NEVENTS];
+static uint64 trace_head;   // 已分配的事件总数
+static int dump_requested;
+
+// 进行中的转储：尚未输出的事件 [dump_pos, dump_end)
+enum { DUMP_IDLE, DUMP_BEGIN, DUMP_EVENTS };
+static int dump_state;
+static int dump_was_enabled;
+static uint64 dump_pos, dump_end;
+
+int trace_enabled;
+
+void trace_record(uint16 type, uint64 arg0, uint64 arg1) {
+    uint64 i = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+    struct trace_event *e = &trace_buf[i % TRACE_NEVENTS];
+    struct proc *p = mycpu()->proc;
+    e->ts = r_cntvct();
+    e->type = type;
+    e->cpu = cpuid();
+    e->pid = p ? p->pid : 0;
+    e->arg0 = arg0;
+    e->arg1 = arg1;
+}
+
+void trace_start(void) {
+    __atomic_store_n(&trace_enabled, 1, __ATOMIC_RELEASE);
+}
+
+void trace_stop(void) {
+    __atomic_store_n(&trace_enabled, 0, __ATOMIC_RELEASE);
+}
+
+// 由控制台中断调用，实际输出推迟到空闲循环
+void trace_request_dump(void) {
+    dump_requested = 1;
+}
+
+// 发送缓冲区放得下时输出一行（行尾 \n 展开成 \r\n），否则返回 0
+static int dump_puts(const char *line, int len) {
+    if(uart_tx_room() <= len)
+        return 0;
+    uart_puts(line);
+    return 1;
+}
+
+// 由空闲循环在开中断时调用，分批输出请求的转储。格式由 tools/trace2json.py 解析：
+//   TRACE_BEGIN <计数器频率> <事件数>
+//   T <ts> <cpu> <pid> <type> <arg0> <arg1>   （十六进制）
+//   TRACE_END
+// 每次只写 UART 发送缓冲区放得下的行，转储期间停止记录。
+// 返回 1 表示送出了一部分且还有剩余，调用者处理完中断和就绪进程后再来
+int trace_poll(void) {
+    char line[128];
+    int len, sent = 0;
+
+    if(dump_state == DUMP_IDLE) {
+        if(!dump_requested)
+            return 0;
+        dump_requested = 0;
+        dump_was_enabled = trace_enabled;
+        trace_stop();
+        dump_end = trace_head;
+        dump_pos = dump_end > TRACE_NEVENTS ? dump_end - TRACE_NEVENTS : 0;
+        dump_state = DUMP_BEGIN;
+    }
+    if(dump_state == DUMP_BEGIN) {
+        len = snprintf(line, sizeof(line), "TRACE_BEGIN %lu %lu\n", r_cntfrq(), dump_end - dump_pos);
+        if(!dump_puts(line, len))
+            return 0;
+        sent = 1;
+        dump_state = DUMP_EVENTS;
+    }
+    for(; dump_pos < dump_end; dump_pos++) {
+        struct trace_event *e = &trace_buf[dump_pos % TRACE_NEVENTS];
+        len = snprintf(line, sizeof(line), "T %lx %x %x %x %lx %lx\n",
+                       e->ts, e->cpu, e->pid, e->type, e->arg0, e->arg1);
+        if(!dump_puts(line, len))
+            return sent;
+        sent = 1;
+    }
+    if(!dump_puts("TRACE_END\n", 10))
+        return sent;
+    dump_state = DUMP_IDLE;
+    if(dump_was_enabled)
+        trace_start();
+    return 0;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "types.h"
+
+// 事件类型
+enum trace_type {
+    TRACE_SCHED_SWITCH = 1, // arg0 = 切出进程 pid，arg1 = 切入进程 pid（0 表示调度器）
+    TRACE_PAGE_ALLOC,       // arg0 = 地址，arg1 = 页数
+    TRACE_PAGE_FREE,        // arg0 = 地址，arg1 = 页数
+    TRACE_BLK_SUBMIT,       // arg0 = 扇区，arg1 = 是否写
+    TRACE_BLK_COMPLETE,     // arg0 = 扇区，arg1 = 状态
+    TRACE_FAT_CLUSTER_READ, // arg0 = 簇号，arg1 = 起始扇区
+};
+
+// 二进制事件记录，32 字节
+struct trace_event {
+    uint64 ts;      // CNTVCT_EL0
+    uint16 type;
+    uint16 cpu;
+    uint32 pid;     // 记录时的当前进程，0 表示无进程上下文
+    uint64 arg0;
+    uint64 arg1;
+};
+
+#ifdef CONFIG_TRACE
+
+extern int trace_enabled;
+
+void trace_record(uint16 type, uint64 arg0, uint64 arg1);
+void trace_start(void);
+void trace_stop(void);
+void trace_request_dump(void);
+int trace_poll(void);
+
+// 关闭时只有一次加载和一条不跳转的分支
+#define trace(type, arg0, arg1)                                   \
+    do {                                                          \
+        if(__builtin_expect(trace_enabled, 0))                    \
+            trace_record((type), (uint64)(arg0), (uint64)(arg1)); \
+    } while(0)
+
+#else
+
+#define trace(type, arg0, arg1) do { } while(0)
+static inline void trace_start(void) { }
+static inline void trace_stop(void) { }
+static inline void trace_request_dump(void) { }
+static inline int trace_poll(void) { return 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,154 @@
+#include "aarch64.h"
+#include "trap.h"
+#include "gic.h"
+#include "fpsimd.h"
+#include "memlayout.h"
+#include "printk.h"
+#include "proc.h"
+#include "syscall.h"
+#include "timer.h"
+#include "vm.h"
+#include "uart.h"
+#include "virtio_blk.h"
+
+// 异常向量表，见 vectors.S
+extern char vectors[];
+
+// 安装异常向量表
+void trap_init(void) {
+    w_vbar_el1((uint64)vectors);
+}
+
+static int panicking;
+
+// 关中断后报告错误并停机
+void panic(const char *msg) {
+    intr_off();
+    // 先送出尚未输出的日志；若 panic 发生在日志路径中则跳过
+    if(!panicking++)
+        log_flush();
+    uart_flush();
+    uart_puts_sync("panic: ");
+    uart_puts_sync(msg);
+    uart_puts_sync("\n");
+    for(;;)
+        asm volatile("wfe");
+}
+
+// 打印陷阱帧中的关键信息
+static void print_trapframe(struct trapframe *tf) {
+    uart_puts_sync("ESR = 0x");
+    uart_put_hex_sync(r_esr_el1());
+    uart_puts_sync("\nELR = 0x");
+    uart_put_hex_sync(tf->elr);
+    uart_puts_sync("\nFAR = 0x");
+    uart_put_hex_sync(r_far_el1());
+    uart_puts_sync("\nSPSR = 0x");
+    uart_put_hex_sync(tf->spsr);
+    uart_puts_sync("\n");
+}
+
+// ESR_EL1 异常类别
+#define ESR_EC(esr)   (((esr) >> 26) & 0x3f)
+#define EC_FP_ACCESS  0x07  // CPACR_EL1.FPEN 拦截的 FP/SIMD 访问
+#define EC_SVC64      0x15  // AArch64 svc 指令
+#define EC_IABT_LOW   0x20  // 来自低异常级的取指异常
+#define EC_DABT_LOW   0x24  // 来自低异常级的数据访问异常
+
+// 取指/数据异常的故障状态码：0x04-0x07 为 L0-L3 转换错误（页表项无效），
+// 0x0c-0x0f 为权限错误
+#define ESR_FSC(esr)  ((esr) & 0x3f)
+#define FSC_IS_TRANSLATION(fsc) (((fsc) & 0x3c) == 0x04)
+#define FSC_IS_PERMISSION(fsc)  (((fsc) & 0x3c) == 0x0c)
+#define ESR_WNR       (1 << 6)  // 数据异常由写操作引起
+
+// EL1 同步异常：目前只有 FP/SIMD 首次访问可以恢复
+void kernel_sync(struct trapframe *tf) {
+    uint64 esr = r_esr_el1();
+    if(ESR_EC(esr) == EC_FP_ACCESS) {
+        fpsimd_trap();
+        return;
+    }
+
+    log_flush();
+    uart_puts_sync("\nkernel_sync: unexpected exception\n");
+    print_trapframe(tf);
+    panic("kernel_sync");
+}
+
+// 用户地址的缺页和权限错误交给 uvm_fault，能处理时返回 0
+static int user_fault(uint64 esr) {
+    uint64 fsc = ESR_FSC(esr);
+    if(!FSC_IS_TRANSLATION(fsc) && !FSC_IS_PERMISSION(fsc))
+        return -1;
+    int write = ESR_EC(esr) == EC_DABT_LOW && (esr & ESR_WNR);
+    return uvm_fault(myproc(), r_far_el1(), write);
+}
+
+// 来自 EL0 的同步异常：系统调用、FP/SIMD 首次访问，其余错误结束进程
+void user_sync(struct trapframe *tf) {
+    uint64 esr = r_esr_el1();
+    switch(ESR_EC(esr)) {
+        case EC_SVC64:
+            // 系统调用期间允许中断，返回用户态前由 vectors.S 关闭
+            intr_on();
+            syscall(tf);
+            break;
+        case EC_FP_ACCESS:
+            fpsimd_trap();
+            break;
+        case EC_IABT_LOW:
+        case EC_DABT_LOW:
+            // 按需分配的栈页和写时复制页，处理后重新执行出错的指令
+            if(user_fault(esr) == 0)
+                break;
+            // fallthrough
+        default:
+            pr_err("pid %lu: 用户态异常 esr=0x%lx elr=0x%lx far=0x%lx，结束进程\n",
+                   myproc()->pid, esr, tf->elr, r_far_el1());
+            intr_on();
+            proc_exit();
+    }
+    preempt_user();
+}
+
+// EL1 IRQ：分发设备中断
+void kernel_irq(struct trapframe *tf) {
+    uint32 irq = gic_claim();
+    if(irq >= GIC_SPURIOUS)
+        return;
+
+    switch(irq) {
+        case UART0_IRQ:
+            uartintr();
+            break;
+        case VIRTIO0_IRQ:
+            virtio_blk_intr();
+            break;
+        case TIMER_IRQ:
+            timerintr();
+            break;
+        default:
+            uart_puts_sync("kernel_irq: unexpected irq 0x");
+            uart_put_hex_sync(irq);
+            uart_puts_sync("\n");
+            break;
+    }
+    gic_complete(irq);
+}
+
+// 来自 EL0 的 IRQ：处理完中断后，时间片用完或有更应该运行的进程时让出 CPU
+void user_irq(struct trapframe *tf) {
+    kernel_irq(tf);
+    preempt_user();
+}
+
+// 未处理的异常向量
+void bad_vector(struct trapframe *tf, uint64 idx) {
+    log_flush();
+    uart_puts_sync("\nbad_vector: 0x");
+    uart_put_hex_sync(idx);
+    uart_puts_sync("\n");
+    print_trapframe(tf);
+    panic("bad_vector");
+}
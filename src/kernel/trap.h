@@ -0,0 +1,18 @@
+#ifndef _TRAP_H
+#define _TRAP_H
+
+#include "types.h"
+
+// 异常入口保存的寄存器，布局与 vectors.S 一致
+struct trapframe {
+    uint64 x[31];  // x0 - x30
+    uint64 sp;     // 异常发生时的栈指针
+    uint64 elr;    // 异常返回地址
+    uint64 spsr;   // 异常发生时的 PSTATE
+};
+
+// 函数声明
+void trap_init(void);
+void panic(const char *msg) __attribute__((noreturn));
+
+#endif
@@ -1,5 +1,10 @@
 #include "uart.h"
+#include "aarch64.h"
 #include "memlayout.h"
+#include "printk.h"
+#include "proc.h"
+#include "trace.h"
+#include "wait.h"
 
 #define UART0_BASE UART0
 
@@ -14,11 +19,32 @@
 #define LCRH_FEN  (1<<4)
 #define LCRH_WLEN_8BIT  (3<<5)
 #define CR     0x30
+#define IMSC   0x38     // 中断屏蔽设置
+#define IMSC_RXIM (1<<4)  // 接收中断
+#define IMSC_TXIM (1<<5)  // 发送中断
+#define IMSC_RTIM (1<<6)  // 接收超时中断
+#define MIS    0x40     // 屏蔽后的中断状态
+#define ICR    0x44     // 中断清除
 
 #define Reg(reg) ((volatile unsigned int *)(UART0_BASE + reg))
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
+// 环形缓冲区大小，必须是2的幂
+#define UART_TX_BUF_SIZE 4096
+#define UART_RX_BUF_SIZE 256
+
+// 发送缓冲区：写者入队后立即返回，由发送中断搬入 FIFO
+static char uart_tx_buf[UART_TX_BUF_SIZE];
+static uint64 uart_tx_w; // 下一个写入位置
+static uint64 uart_tx_r; // 下一个发送位置
+
+// 接收缓冲区：接收中断写入，读者在为空时睡眠
+static char uart_rx_buf[UART_RX_BUF_SIZE];
+static uint64 uart_rx_w;
+static uint64 uart_rx_r;
+static struct wait_queue uart_rx_wait = WAIT_QUEUE_INIT;
+
 void uart_init() {
     // 禁用 UART
     WriteReg(CR, 0);
@@ -26,22 +52,65 @@ void uart_init() {
     // 启用 FIFO，设置 8 位数据位，无校验
     WriteReg(LCRH, LCRH_FEN | LCRH_WLEN_8BIT);
 
+    // 清除残留中断，打开接收中断；发送中断只在缓冲区有积压时打开
+    WriteReg(ICR, 0x7ff);
+    WriteReg(IMSC, IMSC_RXIM | IMSC_RTIM);
+
     // 启用 UART，启用发送和接收
     WriteReg(CR, 0x301);
 
-    uart_puts("UART initialized\n");
+    pr_info("UART initialized\n");
+}
+
+// 把缓冲区中的字符尽量搬入发送 FIFO，调用者需关中断
+static void uart_start(void) {
+    while(uart_tx_r != uart_tx_w) {
+        if(ReadReg(FR) & FR_TXFF) {
+            // FIFO 已满，等发送中断再继续
+            WriteReg(IMSC, ReadReg(IMSC) | IMSC_TXIM);
+            return;
+        }
+        WriteReg(DR, uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]);
+        uart_tx_r++;
+    }
+    // 缓冲区已空，不再需要发送中断
+    WriteReg(IMSC, ReadReg(IMSC) & ~IMSC_TXIM);
 }
 
 void uart_putc(char c) {
-    // 等待发送 FIFO 有空间
-    while(ReadReg(FR) & FR_TXFF);
-    WriteReg(DR, c);
+    push_off();
+    // 缓冲区满时只能同步腾出空间
+    while(uart_tx_w - uart_tx_r == UART_TX_BUF_SIZE) {
+        while(ReadReg(FR) & FR_TXFF);
+        WriteReg(DR, uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]);
+        uart_tx_r++;
+    }
+    uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = c;
+    uart_tx_w++;
+    uart_start();
+    pop_off();
 }
 
 char uart_getc() {
-    // 等待接收 FIFO 有数据
-    while(ReadReg(FR) & FR_RXFE);
-    return ReadReg(DR);
+    // 没有进程上下文时（启动阶段）关中断等待：接收中断挂起会让 WFI 返回，
+    // 字符仍留在 FIFO 里由这里直接读走
+    if(myproc() == 0) {
+        push_off();
+        while(ReadReg(FR) & FR_RXFE)
+            asm volatile("wfi");
+        char c = ReadReg(DR);
+        pop_off();
+        return c;
+    }
+
+    push_off();
+    // 等待接收中断送来数据
+    while(uart_rx_r == uart_rx_w)
+        wait_sleep(&uart_rx_wait);
+    char c = uart_rx_buf[uart_rx_r % UART_RX_BUF_SIZE];
+    uart_rx_r++;
+    pop_off();
+    return c;
 }
 
 void uart_puts(const char *s) {
@@ -70,3 +139,67 @@ void uart_put_hex(uint64 n) {
     uart_puts(hex_str);
 }
 
+// 发送缓冲区的空闲字节数，写入不超过它时 uart_putc 不会同步等待 UART
+uint64 uart_tx_room(void) {
+    return UART_TX_BUF_SIZE - (uart_tx_w - uart_tx_r);
+}
+
+// 同步清空发送缓冲区，用于停机前保证输出完整
+void uart_flush(void) {
+    push_off();
+    while(uart_tx_r != uart_tx_w) {
+        while(ReadReg(FR) & FR_TXFF);
+        WriteReg(DR, uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]);
+        uart_tx_r++;
+    }
+    pop_off();
+}
+
+// UART 中断处理：收取输入、继续发送
+void uartintr(void) {
+    WriteReg(ICR, ReadReg(MIS));
+
+    while(!(ReadReg(FR) & FR_RXFE)) {
+        char c = ReadReg(DR);
+        // Ctrl-T：请求转储事件跟踪缓冲区，不交给读者
+        if(c == 0x14) {
+            trace_request_dump();
+            continue;
+        }
+        // Ctrl-P：打印进程列表和 PMU 统计
+        if(c == 0x10) {
+            procdump_request();
+            continue;
+        }
+        // 缓冲区满时丢弃新字符
+        if(uart_rx_w - uart_rx_r < UART_RX_BUF_SIZE) {
+            uart_rx_buf[uart_rx_w % UART_RX_BUF_SIZE] = c;
+            uart_rx_w++;
+            // 每个字符只唤醒一个读者，避免惊群
+            wake_one(&uart_rx_wait);
+        }
+    }
+
+    uart_start();
+}
+
+void uart_putc_sync(char c) {
+    // 等待发送 FIFO 有空间
+    while(ReadReg(FR) & FR_TXFF);
+    WriteReg(DR, c);
+}
+
+void uart_puts_sync(const char *s) {
+    while (*s) {
+        if (*s == '\n') {
+            uart_putc_sync('\r');
+        }
+        uart_putc_sync(*s++);
+    }
+}
+
+void uart_put_hex_sync(uint64 n) {
+    const char hex_chars[] = "0123456789ABCDEF";
+    for(int i = 60; i >= 0; i -= 4)
+        uart_putc_sync(hex_chars[(n >> i) & 0xF]);
+}
@@ -8,5 +8,13 @@ void uart_putc(char c);
 char uart_getc(void);
 void uart_puts(const char *str);
 void uart_put_hex(uint64 n);
+void uart_flush(void);
+uint64 uart_tx_room(void);
+void uartintr(void);
+
+// 轮询方式输出，不经过缓冲区，用于 panic 和性能对比
+void uart_putc_sync(char c);
+void uart_puts_sync(const char *str);
+void uart_put_hex_sync(uint64 n);
 
 #endif
@@ -1,7 +1,12 @@
 #include "virtio_blk.h"
-#include "uart.h"
+#include "blk.h"
+#include "gic.h"
+#include "printk.h"
 #include "memlayout.h"
 #include "mm.h"
+#include "proc.h"
+#include "trace.h"
+#include "wait.h"
 
 // 获取virtio MMIO寄存器地址
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
@@ -37,14 +42,26 @@ static struct disk {
         char status;
         int write;
         uint32 sector;
+        int done;      // 设备已完成，由中断处理置位
+        struct blk_req *req;   // 块层的请求，virtio_blk_rw 的同步请求为 0
     } info[VIRTIO_NUM_DESC];
 
+    // 设备支持 FLUSH 命令
+    int has_flush;
+
+    // 等待请求完成或空闲描述符的进程
+    struct wait_queue wq;
+
     // 磁盘命令头
     // 与描述符一一对应，方便使用
     struct virtio_blk_req ops[VIRTIO_NUM_DESC];
 
 } __attribute__ ((aligned (PGSIZE))) disk;
 
+// 在块层注册的设备 "vda"
+static struct blk_dev vda;
+static int virtio_blk_submit(struct blk_dev *d, struct blk_req *r);
+
 // 初始化virtio块设备
 void virtio_blk_init(void) {
     uint32 status = 0;
@@ -59,7 +76,7 @@ void virtio_blk_init(void) {
        version != 1 ||
        device_id != 2 ||
        vendor_id != 0x554d4551) {
-        uart_puts("ERROR: could not find virtio disk\n");
+        pr_err("ERROR: could not find virtio disk\n");
         return;
     }
 
@@ -81,6 +98,7 @@ void virtio_blk_init(void) {
     features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
     features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
     *R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
+    disk.has_flush = (features >> VIRTIO_BLK_F_FLUSH) & 1;
 
     // 告诉设备特性协商完成
     status |= VIRTIO_CONFIG_S_FEATURES_OK;
@@ -96,16 +114,16 @@ void virtio_blk_init(void) {
     *R(VIRTIO_MMIO_QUEUE_SEL) = 0;
     uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
     if(max == 0) {
-        uart_puts("ERROR: virtio disk has no queue 0\n");
+        pr_err("ERROR: virtio disk has no queue 0\n");
         return;
     }
     if(max < VIRTIO_NUM_DESC) {
-        uart_puts("ERROR: virtio disk max queue too short\n");
+        pr_err("ERROR: virtio disk max queue too short\n");
         return;
     }
     *R(VIRTIO_MMIO_QUEUE_NUM) = VIRTIO_NUM_DESC;
     memset(disk.pages, 0, sizeof(disk.pages));
-    *R(VIRTIO_MMIO_QUEUE_PFN) = (uint64)disk.pages >> PGSHIFT;
+    *R(VIRTIO_MMIO_QUEUE_PFN) = V2P(disk.pages) >> PGSHIFT;
 
     // 设置描述符、可用环和已用环的指针
     disk.desc = (struct virtq_desc *) disk.pages;
@@ -120,7 +138,15 @@ void virtio_blk_init(void) {
     // 设置队列就绪
     *R(VIRTIO_MMIO_QUEUE_READY) = 1;
 
-    uart_puts("Virtio block device initialized\n");
+    wait_queue_init(&disk.wq);
+    gic_enable_irq(VIRTIO0_IRQ);
+
+    vda.name = "vda";
+    vda.nsectors = *R(VIRTIO_MMIO_CONFIG) | (uint64)*R(VIRTIO_MMIO_CONFIG + 4) << 32;
+    vda.submit = virtio_blk_submit;
+    blk_register(&vda, "deadline");
+
+    pr_info("Virtio block device initialized\n");
 }
 
 // 查找空闲描述符，标记为非空闲，返回其索引
@@ -137,11 +163,11 @@ static int alloc_desc(void) {
 // 标记描述符为空闲
 static void free_desc(int i) {
     if(i >= VIRTIO_NUM_DESC) {
-        uart_puts("ERROR: free_desc: invalid index\n");
+        pr_err("ERROR: free_desc: invalid index\n");
         return;
     }
     if(disk.free[i]) {
-        uart_puts("ERROR: free_desc: already free\n");
+        pr_err("ERROR: free_desc: already free\n");
         return;
     }
     disk.desc[i].addr = 0;
@@ -164,10 +190,9 @@ static void free_chain(int i) {
     }
 }
 
-// 分配三个描述符（不需要连续）
-// 磁盘传输总是使用三个描述符
-static int alloc3_desc(int *idx) {
-    for(int i = 0; i < 3; i++) {
+// 分配 n 个描述符（不需要连续）
+static int alloc_descs(int *idx, int n) {
+    for(int i = 0; i < n; i++) {
         idx[i] = alloc_desc();
         if(idx[i] < 0) {
             for(int j = 0; j < i; j++)
@@ -178,81 +203,172 @@ static int alloc3_desc(int *idx) {
     return 0;
 }
 
-static void wait_for_done(void) {
-    while(disk.used->idx == disk.used_idx) {
-        // 检查并确认设备中断
-        uint32 status = *R(VIRTIO_MMIO_INTERRUPT_STATUS);
-        if (status & 1) { // Bit 0 表示“已用缓冲区通知”
-            *R(VIRTIO_MMIO_INTERRUPT_ACK) = status; // 确认中断
-            asm volatile("dsb sy" ::: "memory");
-        }
+// r 需要的数据描述符数：缓冲区首尾相接的段可以合用一个
+static int data_descs(struct blk_req *r) {
+    int n = 0;
+    char *end = 0;
+    for(struct blk_req *s = r->first; s; s = s->seg) {
+        if(n == 0 || s->buf != end)
+            n++;
+        end = s->buf + s->nsect * 512;
     }
+    return n;
 }
 
-// 块设备读写操作
-int virtio_blk_rw(char *buf, uint32 sector, int write) {
-    int idx[3];
-    char status = 0xFF; // 初始化 status 为一个非零值，以便观察变化
-
-    // 分配三个描述符
-    if(alloc3_desc(idx) < 0) {
-        uart_puts("ERROR: failed to allocate descriptors\n");
-        return -1;
-    }
-
+// 用 idx 中的描述符为 r 填写一条链并通知设备，调用者需关中断：请求头、数据描述符（个数见 data_descs）、
+// 状态字节。FLUSH 没有数据段。async 为 0 时完成后由提交者自己收取
+static void blk_start(int *idx, uint32 type, struct blk_req *r, int async) {
     // 设置请求头
     struct virtio_blk_req *req = &disk.ops[idx[0]];
-    req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    req->type = type;
     req->reserved = 0;
-    req->sector = sector;
+    req->sector = r->start;
 
     // 设置第一个描述符（请求头）
-    disk.desc[idx[0]].addr = (uint64)req;
+    disk.desc[idx[0]].addr = V2P(req);
     disk.desc[idx[0]].len = sizeof(struct virtio_blk_req);
     disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
     disk.desc[idx[0]].next = idx[1];
 
-    // 设置第二个描述符（数据缓冲区）
-    disk.desc[idx[1]].addr = (uint64)buf;
-    disk.desc[idx[1]].len = 512; // 扇区大小
-    disk.desc[idx[1]].flags = VRING_DESC_F_NEXT | (write ? 0 : VRING_DESC_F_WRITE);
-    disk.desc[idx[1]].next = idx[2];
+    // 数据描述符，设备看到的是物理地址；缓冲区首尾相接的段合用一个
+    int n = 0;
+    char *end = 0;
+    for(struct blk_req *s = r->first; s && type != VIRTIO_BLK_T_FLUSH; s = s->seg) {
+        if(n > 0 && s->buf == end) {
+            disk.desc[idx[n]].len += s->nsect * 512;
+        } else {
+            n++;
+            disk.desc[idx[n]].addr = V2P(s->buf);
+            disk.desc[idx[n]].len = s->nsect * 512;
+            disk.desc[idx[n]].flags = VRING_DESC_F_NEXT | (type == VIRTIO_BLK_T_OUT ? 0 : VRING_DESC_F_WRITE);
+            disk.desc[idx[n]].next = idx[n + 1];
+        }
+        end = s->buf + s->nsect * 512;
+    }
+    n++;
 
-    // 设置第三个描述符（状态字节）
-    disk.desc[idx[2]].addr = (uint64)&status;
-    disk.desc[idx[2]].len = 1;
-    disk.desc[idx[2]].flags = VRING_DESC_F_WRITE;
-    disk.desc[idx[2]].next = 0;
+    // 最后一个描述符（状态字节），初始化为非零值，以便观察变化
+    disk.info[idx[0]].status = 0xFF;
+    disk.desc[idx[n]].addr = V2P(&disk.info[idx[0]].status);
+    disk.desc[idx[n]].len = 1;
+    disk.desc[idx[n]].flags = VRING_DESC_F_WRITE;
+    disk.desc[idx[n]].next = 0;
 
     // 保存操作信息
-    disk.info[idx[0]].buf = buf;
-    disk.info[idx[0]].write = write;
-    disk.info[idx[0]].sector = sector;
+    disk.info[idx[0]].buf = r->buf;
+    disk.info[idx[0]].write = type == VIRTIO_BLK_T_OUT;
+    disk.info[idx[0]].sector = r->start;
+    disk.info[idx[0]].done = 0;
+    disk.info[idx[0]].req = async ? r : 0;
 
     // 将描述符添加到可用环
     int avail_idx = disk.avail->idx % VIRTIO_NUM_DESC;
     disk.avail->ring[avail_idx] = idx[0];
+    asm volatile("dsb sy" ::: "memory");
     disk.avail->idx++;
+    asm volatile("dsb sy" ::: "memory");
 
     // 通知设备
     *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0;
+    trace(TRACE_BLK_SUBMIT, r->start, type == VIRTIO_BLK_T_OUT);
+}
 
-    // 等待完成
-    wait_for_done();
-
-    // 处理完成的请求
-    while(disk.used->idx != disk.used_idx) {
+// 收取已完成的请求并唤醒等待者，调用者需关中断。
+// 块层的请求在这里释放描述符并交回块层，同步请求由提交者自己释放
+static void virtio_blk_complete(void) {
+    *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+    // 先看到 used->idx 的更新，再读环里的条目
+    asm volatile("dsb sy" ::: "memory");
+    while(disk.used_idx != disk.used->idx) {
         int id = disk.used->ring[disk.used_idx % VIRTIO_NUM_DESC].id;
-        free_chain(id);
         disk.used_idx++;
+        struct blk_req *r = disk.info[id].req;
+        if(!r) {
+            disk.info[id].done = 1;
+            continue;
+        }
+        int status = disk.info[id].status;
+        disk.info[id].req = 0;
+        free_chain(id);
+        trace(TRACE_BLK_COMPLETE, r->start, status);
+        // 块层接着发出排队的请求，刚释放的描述符马上被用上
+        blk_end(&vda, r, status ? -1 : 0);
     }
+    wake_all(&disk.wq);
+}
+
+// 设备中断
+void virtio_blk_intr(void) {
+    virtio_blk_complete();
+}
+
+// 等待以 id 开头的请求完成。进程睡眠等中断唤醒；没有进程上下文（启动阶段）时
+// 关中断执行 WFI，挂起的设备中断会让它返回，再直接收取完成的请求
+static void wait_for_done(int id) {
+    if(myproc() == 0) {
+        push_off();
+        while(!disk.info[id].done) {
+            asm volatile("wfi");
+            virtio_blk_complete();
+        }
+        pop_off();
+        return;
+    }
+    wait_event(&disk.wq, disk.info[id].done);
+}
+
+// 绕过块层直接读写一个扇区，用于驱动自检和测量设备本身的延迟
+int virtio_blk_rw(char *buf, uint32 sector, int write) {
+    int idx[3];
+    struct blk_req r = { .buf = buf, .sector = sector, .nsect = 1 };
+    r.first = &r;
+    r.start = sector;
+
+    // 分配三个描述符，全部占用时等其他请求完成
+    if(myproc() == 0) {
+        if(alloc_descs(idx, 3) < 0) {
+            pr_err("ERROR: failed to allocate descriptors\n");
+            return -1;
+        }
+    } else {
+        wait_event(&disk.wq, alloc_descs(idx, 3) == 0);
+    }
+
+    push_off();
+    blk_start(idx, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, &r, 0);
+    pop_off();
+
+    // 等待完成
+    wait_for_done(idx[0]);
+
+    push_off();
+    int status = disk.info[idx[0]].status;
+    free_chain(idx[0]);
+    // 块层可能有请求或进程在等空闲描述符
+    wake_all(&disk.wq);
+    pop_off();
+    blk_kick(&vda);
+    trace(TRACE_BLK_COMPLETE, sector, status);
 
     // 检查状态
     if(status != 0) {
-        uart_puts("ERROR: disk operation failed with status ");
-        uart_put_hex(status);
-        uart_puts("!\n");
+        pr_err("ERROR: disk operation failed with status %d!\n", status);
         return -1;
     }
     return 0;
 }
+
+// 块层的 submit：一个合并请求占 数据描述符数 + 2 个描述符，不够时返回 -1，由块层留着等 blk_kick 或下一次完成。
+// 设备不支持 FLUSH 时没有需要刷新的写缓存，直接完成
+static int virtio_blk_submit(struct blk_dev *d, struct blk_req *r) {
+    int idx[BLK_MAX_SEGS + 2];
+    if(r->op == BLK_FLUSH && !disk.has_flush) {
+        blk_end(d, r, 0);
+        return 0;
+    }
+    if(alloc_descs(idx, r->op == BLK_FLUSH ? 2 : data_descs(r) + 2) < 0)
+        return -1;
+    uint32 type = r->op == BLK_FLUSH ? VIRTIO_BLK_T_FLUSH : r->op == BLK_WRITE ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    blk_start(idx, type, r, 1);
+    return 0;
+}
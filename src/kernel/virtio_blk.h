@@ -21,6 +21,7 @@
 #define VIRTIO_MMIO_INTERRUPT_STATUS   0x060 // 只读
 #define VIRTIO_MMIO_INTERRUPT_ACK      0x064 // 只写
 #define VIRTIO_MMIO_STATUS             0x070 // 读/写
+#define VIRTIO_MMIO_CONFIG             0x100 // 设备配置空间，块设备开头是 64 位的扇区数
 
 // 状态寄存器位定义
 #define VIRTIO_CONFIG_S_ACKNOWLEDGE    1
@@ -30,6 +31,7 @@
 
 // 设备特性位定义
 #define VIRTIO_BLK_F_RO                5    // 磁盘为只读
+#define VIRTIO_BLK_F_FLUSH             9    // 支持刷新写缓存
 #define VIRTIO_BLK_F_SCSI              7    // 支持SCSI命令直通
 #define VIRTIO_BLK_F_CONFIG_WCE        11   // 配置中可用写回模式
 #define VIRTIO_BLK_F_MQ                12   // 支持多个虚拟队列
@@ -37,8 +39,8 @@
 #define VIRTIO_RING_F_INDIRECT_DESC    28
 #define VIRTIO_RING_F_EVENT_IDX        29
 
-// 描述符数量，必须是2的幂
-#define VIRTIO_NUM_DESC                8
+// 描述符数量，必须是2的幂；每个请求占请求头、数据（缓冲区不相接的每段一个）、状态字节
+#define VIRTIO_NUM_DESC                32
 
 // 单个描述符结构
 struct virtq_desc {
@@ -75,6 +77,7 @@ struct virtq_used {
 // 块设备特定的定义
 #define VIRTIO_BLK_T_IN  0 // 读取磁盘
 #define VIRTIO_BLK_T_OUT 1 // 写入磁盘
+#define VIRTIO_BLK_T_FLUSH 4 // 刷新写缓存
 
 // 磁盘请求格式
 struct virtio_blk_req {
@@ -86,5 +89,6 @@ struct virtio_blk_req {
 // 函数声明
 void virtio_blk_init(void);
 int virtio_blk_rw(char *buf, uint32 sector, int write);
+void virtio_blk_intr(void);
 
 #endif
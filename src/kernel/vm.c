@@ -0,0 +1,570 @@
+#include "vm.h"
+#include "aarch64.h"
+#include "ipc.h"
+#include "memlayout.h"
+#include "mm.h"
+#include "pagecache.h"
+#include "printk.h"
+#include "proc.h"
+#include "trap.h"
+
+// 进程地址空间：每个用户进程一张四级页表，切换进程时写 TTBR0_EL1；
+// 内核由 TTBR1_EL1 的线性映射访问（boot.S 先用 1GiB 块建立，vm_init 再按段权限重建），
+// 所有进程共享，不随切换变化。
+// 用户页带 nG 位，TLB 项以 ASID 区分，切换地址空间不需要刷新 TLB。
+
+// 取 va 在第 level 级页表中的下标
+#define PX(level, va) (((uint64)(va) >> (39 - 9 * (level))) & 0x1ff)
+
+// 8 位 ASID（TCR_EL1.AS = 0），ASID 0 留给内核线程的空页表
+#define ASID_BITS 8
+#define NASID (1UL << ASID_BITS)
+#define ASID_MASK (NASID - 1)
+
+// 每个地址空间的 asid 字段高位是分配时的代，低 ASID_BITS 位是硬件 ASID。
+// 代内按顺序发放，用完时代加一并刷新整个 TLB，
+// 旧代的地址空间下次切入时再重新分配，不需要逐个回收。
+// 只有一个 CPU，不必追踪其他 CPU 上正在使用的 ASID
+static uint64 asid_generation = NASID;
+static uint64 asid_next = 1;
+static uint64 asid_rollovers;
+
+// 关闭后所有地址空间共用 ASID 0，每次切换都刷新，用于对比测量
+static int asid_enabled = 1;
+
+// 内核线程使用的空用户页表
+static pagetable_t empty_pgd;
+
+static inline void w_ttbr0(uint64 x) {
+    asm volatile("msr ttbr0_el1, %0; isb" : : "r" (x));
+}
+
+// 刷新全部 TLB 项
+static inline void tlb_flush_all(void) {
+    asm volatile("dsb ishst; tlbi vmalle1; dsb ish; isb" ::: "memory");
+}
+
+// 刷新 ASID 0 的非全局 TLB 项
+static inline void tlb_flush_asid0(void) {
+    asm volatile("dsb ishst; tlbi aside1, xzr; dsb ish; isb" ::: "memory");
+}
+
+// 进程 p 在 TLB 中使用的 ASID，p 必须是当前进程
+static inline uint64 tlb_asid(struct proc *p) {
+    return (asid_enabled ? p->asid & ASID_MASK : 0) << 48;
+}
+
+// 刷新当前进程 p 中 va 所在页的 TLB 项
+static inline void tlb_flush_page(struct proc *p, uint64 va) {
+    asm volatile("dsb ishst; tlbi vae1, %0; dsb ish; isb"
+                 : : "r" (tlb_asid(p) | (va >> PAGE_SHIFT)) : "memory");
+}
+
+// 刷新当前进程 p 的全部 TLB 项
+static inline void tlb_flush_proc(struct proc *p) {
+    asm volatile("dsb ishst; tlbi aside1, %0; dsb ish; isb"
+                 : : "r" (tlb_asid(p)) : "memory");
+}
+
+void vm_init(void) {
+    // 空页表同时是 kernel_remap 切换 TTBR1 时的过渡页表，要先分配
+    empty_pgd = alloc_pages(1);
+    if(!empty_pgd)
+        panic("vm_init");
+    memset(empty_pgd, 0, PAGE_SIZE);
+    kernel_remap(1);
+
+    // 不再需要启动时的恒等映射
+    w_ttbr0(V2P(empty_pgd));
+    tlb_flush_all();
+}
+
+static uint64 asid_alloc(void) {
+    if(asid_next == NASID) {
+        asid_generation += NASID;
+        asid_next = 1;
+        asid_rollovers++;
+        tlb_flush_all();
+    }
+    return asid_generation | asid_next++;
+}
+
+// 切换用户地址空间；pgd 为 0 时装入空页表（内核线程）
+// asid 指向地址空间的 ASID 记录，属于旧代时就地重新分配
+void vm_switch(pagetable_t pgd, uint64 *asid) {
+    if(pgd == 0) {
+        w_ttbr0(V2P(empty_pgd));
+        return;
+    }
+    if(!asid_enabled) {
+        w_ttbr0(V2P(pgd));
+        tlb_flush_asid0();
+        return;
+    }
+    if((*asid & ~ASID_MASK) != asid_generation)
+        *asid = asid_alloc();
+    w_ttbr0(V2P(pgd) | (*asid & ASID_MASK) << 48);
+}
+
+void vm_set_asid(int enabled) {
+    asid_enabled = enabled;
+    // 重新开始一代，避免沿用关闭期间 ASID 0 的 TLB 项
+    asid_next = NASID;
+}
+
+uint64 vm_asid_rollovers(void) {
+    return asid_rollovers;
+}
+
+// 返回 va 在第 level 级页表中的表项，alloc 非 0 时补齐中间级页表
+static uint64 *walk_level(pagetable_t pgd, uint64 va, int level, int alloc) {
+    pagetable_t t = pgd;
+    for(int l = 0; l < level; l++) {
+        uint64 *pte = &t[PX(l, va)];
+        if(*pte & PTE_VALID) {
+            t = (pagetable_t)P2V(PTE_ADDR(*pte));
+        } else {
+            if(!alloc || (t = alloc_pages_flags(1, ALLOC_ZERO)) == 0)
+                return 0;
+            *pte = V2P(t) | PTE_TABLE | PTE_VALID;
+        }
+    }
+    return &t[PX(level, va)];
+}
+
+// 返回 va 对应的 L3 页表项，alloc 非 0 时补齐中间级页表
+uint64 *walk(pagetable_t pgd, uint64 va, int alloc) {
+    return walk_level(pgd, va, 3, alloc);
+}
+
+// 内核线性映射（TTBR1）：设备区用 1GiB 块，RAM 尽量用 1GiB/2MiB 块。
+// 内核映像所在的 2MiB 因权限不同拆成 4KB 页：代码只读可执行，只读数据和可写数据都不可执行；
+// 其中 16 个对齐且属性相同的页带连续位，TLB 可以把它们合成一项
+
+#define SZ_2M (2UL << 20)
+#define SZ_1G (1UL << 30)
+#define SZ_64K (64UL << 10)
+
+// 内核映像各段边界，见 kernel.ld
+extern char _text[], _etext[], _erodata[];
+
+// boot.S：启动页表（低地址是恒等映射）和切换 TTBR1 的例程
+extern char boot_pgd[];
+void replace_ttbr1(uint64 ttbr1, uint64 reserved, uint64 idmap);
+
+static pagetable_t kernel_pgd;  // 当前 TTBR1 页表，0 表示仍在用 boot.S 的启动页表
+
+static struct {
+    uint64 block_1g, block_2m, page_cont, page_4k;
+} kmap_stats;
+
+// 物理地址 pa 在线性映射中的访问权限
+static uint64 kernel_perm(uint64 pa) {
+    uint64 va = P2V(pa);
+    if(va >= (uint64)_text && va < (uint64)_etext)
+        return PTE_RDONLY | PTE_UXN;
+    if(va >= (uint64)_etext && va < (uint64)_erodata)
+        return PTE_RDONLY | PTE_UXN | PTE_PXN;
+    return PTE_UXN | PTE_PXN;
+}
+
+// [pa, pa + size) 内权限是否一致：段边界不能落在区间内部
+static int kernel_uniform(uint64 pa, uint64 size) {
+    uint64 bounds[] = { V2P(_text), V2P(_etext), V2P(_erodata) };
+    for(int i = 0; i < 3; i++)
+        if(bounds[i] > pa && bounds[i] < pa + size)
+            return 0;
+    return 1;
+}
+
+// 映射一段 RAM；large 为 0 时全部使用 4KB 页，用于对比
+static void kernel_map_ram(pagetable_t pgd, uint64 pa, uint64 end, int large) {
+    uint64 attr = PTE_AF | PTE_SH | PTE_ATTR(MT_NORMAL) | PTE_VALID;
+    while(pa < end) {
+        uint64 *pte;
+        if(large && (pa & (SZ_1G - 1)) == 0 && pa + SZ_1G <= end && kernel_uniform(pa, SZ_1G)) {
+            if(!(pte = walk_level(pgd, P2V(pa), 1, 1)))
+                panic("kernel_map_ram");
+            *pte = pa | kernel_perm(pa) | attr;
+            kmap_stats.block_1g++;
+            pa += SZ_1G;
+        } else if(large && (pa & (SZ_2M - 1)) == 0 && pa + SZ_2M <= end && kernel_uniform(pa, SZ_2M)) {
+            if(!(pte = walk_level(pgd, P2V(pa), 2, 1)))
+                panic("kernel_map_ram");
+            *pte = pa | kernel_perm(pa) | attr;
+            kmap_stats.block_2m++;
+            pa += SZ_2M;
+        } else {
+            if(!(pte = walk_level(pgd, P2V(pa), 3, 1)))
+                panic("kernel_map_ram");
+            uint64 group = pa & ~(SZ_64K - 1);
+            uint64 cont = 0;
+            if(large && group >= MEM_START && group + SZ_64K <= end && kernel_uniform(group, SZ_64K)) {
+                cont = PTE_CONT;
+                kmap_stats.page_cont++;
+            } else {
+                kmap_stats.page_4k++;
+            }
+            *pte = pa | kernel_perm(pa) | attr | cont | PTE_PAGE;
+            pa += PAGE_SIZE;
+        }
+    }
+}
+
+// 释放内核页表本身（不涉及映射的内存）
+static void kernel_free_tables(pagetable_t t, int level) {
+    for(int i = 0; level < 3 && i < 512; i++) {
+        // 块描述符 bit1 为 0，不是下一级页表
+        if((t[i] & (PTE_VALID | PTE_TABLE)) == (PTE_VALID | PTE_TABLE))
+            kernel_free_tables((pagetable_t)P2V(PTE_ADDR(t[i])), level + 1);
+    }
+    free_pages(t, 1);
+}
+
+// 重建内核线性映射并切换 TTBR1。large 为 0 时 RAM 全部用 4KB 页，只用于测量对比
+void kernel_remap(int large) {
+    pagetable_t pgd = alloc_pages(1);
+    if(!pgd)
+        panic("kernel_remap");
+    memset(pgd, 0, PAGE_SIZE);
+    memset(&kmap_stats, 0, sizeof(kmap_stats));
+
+    // 设备寄存器所在的低 1GiB
+    uint64 *pte = walk_level(pgd, P2V(0), 1, 1);
+    if(!pte)
+        panic("kernel_remap");
+    *pte = PTE_UXN | PTE_PXN | PTE_AF | PTE_ATTR(MT_DEVICE) | PTE_VALID;
+    kmap_stats.block_1g++;
+    kernel_map_ram(pgd, MEM_START, MEM_END, large);
+
+    // 新旧页表映射同样的地址但块大小不同，经空页表过渡切换，见 boot.S
+    replace_ttbr1(V2P(pgd), V2P(empty_pgd), V2P(boot_pgd));
+    if(kernel_pgd)
+        kernel_free_tables(kernel_pgd, 0);
+    kernel_pgd = pgd;
+    pr_info("内核线性映射: 1GiB 块 %lu, 2MiB 块 %lu, 连续 4KB 页 %lu, 4KB 页 %lu\n",
+            kmap_stats.block_1g, kmap_stats.block_2m, kmap_stats.page_cont, kmap_stats.page_4k);
+}
+
+// 新建空的用户页表
+pagetable_t uvm_create(void) {
+    return alloc_pages_flags(1, ALLOC_ZERO);
+}
+
+// 把物理页 [pa, pa + size) 映射到用户地址 va，va、pa、size 按页对齐
+int uvm_map(pagetable_t pgd, uint64 va, uint64 size, uint64 pa, uint64 perm) {
+    for(uint64 off = 0; off < size; off += PAGE_SIZE) {
+        uint64 *pte = walk(pgd, va + off, 1);
+        if(!pte)
+            return -1;
+        if(*pte & PTE_VALID)
+            panic("uvm_map: remap");
+        *pte = (pa + off) | perm | PTE_NG | PTE_PXN | PTE_AF | PTE_SH |
+               PTE_ATTR(MT_NORMAL) | PTE_PAGE | PTE_VALID;
+    }
+    // 页表更新先于之后的访问对遍历器可见
+    asm volatile("dsb ishst" ::: "memory");
+    return 0;
+}
+
+static void freewalk(pagetable_t t, int level) {
+    for(int i = 0; i < 512; i++) {
+        uint64 pte = t[i];
+        if(!(pte & PTE_VALID))
+            continue;
+        void *next = (void *)P2V(PTE_ADDR(pte));
+        if(level < 3)
+            freewalk(next, level + 1);
+        else
+            page_put(next);
+    }
+    free_pages(t, 1);
+}
+
+// 释放用户页表，并放弃对其中映射的全部页的引用，调用者保证它不是当前的 TTBR0。
+// 残留的 TLB 项带着已作废的 ASID，换代刷新之前这个 ASID 不会再发出去
+void uvm_free(pagetable_t pgd) {
+    freewalk(pgd, 0);
+}
+
+static int copy_level(pagetable_t src, pagetable_t dst, int level) {
+    for(int i = 0; i < 512; i++) {
+        uint64 pte = src[i];
+        if(!(pte & PTE_VALID))
+            continue;
+        if(level < 3) {
+            pagetable_t t = alloc_pages_flags(1, ALLOC_ZERO);
+            if(!t)
+                return -1;
+            dst[i] = V2P(t) | PTE_TABLE | PTE_VALID;
+            if(copy_level((pagetable_t)P2V(PTE_ADDR(pte)), t, level + 1) < 0)
+                return -1;
+        } else {
+            if(pte & PTE_SHARED) {
+                // 页缓存页双方共享；子进程先只读，第一次写入时再标记脏页
+                dst[i] = pte | PTE_RDONLY;
+                page_get((void *)P2V(PTE_ADDR(pte)));
+                continue;
+            }
+            if(!(pte & PTE_RDONLY)) {
+                pte |= PTE_RDONLY | PTE_COW;
+                src[i] = pte;
+            }
+            dst[i] = pte;
+            page_get((void *)P2V(PTE_ADDR(pte)));
+        }
+    }
+    return 0;
+}
+
+// 复制地址空间：dst 与 src 共享全部物理页，可写页在双方都改成只读并标记写时复制。
+// 只遍历和复制页表，不拷贝数据，耗时与页表大小成正比。src 必须是当前进程；
+// 失败时 dst 中已建立的部分由调用者 uvm_free
+int uvm_copy(struct proc *src, struct proc *dst) {
+    int r = copy_level(src->pagetable, dst->pagetable, 0);
+    // src 的可写映射变成了只读
+    tlb_flush_proc(src);
+    return r;
+}
+
+// 写时复制：只剩一个引用时直接恢复可写，否则复制一份私有页
+static int uvm_cow(struct proc *p, uint64 va, uint64 *pte) {
+    uint8 *old = (uint8 *)P2V(PTE_ADDR(*pte));
+    uint64 flags = (*pte & ~PTE_ADDR(~0UL)) & ~(PTE_RDONLY | PTE_COW);
+    if(page_refcount(old) == 1) {
+        // 只改权限，不需要先拆除映射
+        *pte = PTE_ADDR(*pte) | flags;
+        tlb_flush_page(p, va);
+        return 0;
+    }
+    uint8 *page = alloc_pages(1);
+    if(!page)
+        return -1;
+    memcpy(page, old, PAGE_SIZE);
+    if(!(flags & PTE_UXN))
+        sync_icache(page, PAGE_SIZE);
+    // 换物理页要先拆除旧映射并刷新 TLB，再写入新映射
+    *pte = 0;
+    tlb_flush_page(p, va);
+    *pte = V2P(page) | flags;
+    asm volatile("dsb ishst" ::: "memory");
+    page_put(old);
+    return 0;
+}
+
+static struct vma *vma_find(struct proc *p, uint64 va) {
+    for(int i = 0; i < NVMA; i++)
+        if(p->vma[i].end && va >= p->vma[i].start && va < p->vma[i].end)
+            return &p->vma[i];
+    return 0;
+}
+
+// 文件映射区缺页：映射页缓存中的页。页先以只读映射，第一次写入时标记脏页再放开写权限，
+// msync 写回后重新改成只读
+static int vma_fault(struct proc *p, struct vma *v, uint64 va, uint64 *pte, int write) {
+    if(write && !v->writable)
+        return -1;
+    uint32 index = v->pgoff + (va - v->start) / PAGE_SIZE;
+    if(pte && (*pte & PTE_VALID)) {
+        if(!write)
+            return -1;
+        pcache_dirty(v->name, index);
+        *pte &= ~PTE_RDONLY;
+        tlb_flush_page(p, va);
+        return 0;
+    }
+    uint8 *page = pcache_get(v->name, index);
+    if(!page)
+        return -1;
+    page_get(page);
+    if(uvm_map(p->pagetable, va, PAGE_SIZE, V2P(page), (write ? UVM_RW : UVM_RO) | PTE_SHARED) < 0) {
+        page_put(page);
+        return -1;
+    }
+    if(write)
+        pcache_dirty(v->name, index);
+    return 0;
+}
+
+// 用户地址缺页：写时复制页的写入，文件映射区，以及栈保留区和 IPC 缓冲区内尚未分配的页（分配清零的物理页）。
+// 成功返回 0；地址不属于任何可处理的情况时返回 -1，保护页另有提示
+int uvm_fault(struct proc *p, uint64 va, int write) {
+    va = PGROUNDDOWN(va);
+    uint64 *pte = walk(p->pagetable, va, 0);
+    struct vma *v = vma_find(p, va);
+    if(v)
+        return vma_fault(p, v, va, pte, write);
+    if(pte && (*pte & PTE_VALID)) {
+        if(write && (*pte & PTE_COW))
+            return uvm_cow(p, va, pte);
+        // 不属于文件映射区的共享页是 IPC 通道的共享页，fork 后子进程先只读，直接恢复可写
+        if(write && (*pte & PTE_SHARED)) {
+            *pte &= ~PTE_RDONLY;
+            tlb_flush_page(p, va);
+            return 0;
+        }
+        return -1;
+    }
+    int stack = va >= USER_STACK_GUARD + PAGE_SIZE && va < USER_STACK_TOP;
+    if(stack || (va >= IPC_BUF_BASE && va < IPC_BUF_END)) {
+        uint8 *page = alloc_pages_flags(1, ALLOC_ZERO);
+        if(!page)
+            return -1;
+        if(uvm_map(p->pagetable, va, PAGE_SIZE, V2P(page), UVM_RW) < 0) {
+            free_pages(page, 1);
+            return -1;
+        }
+        // 栈页直到进程退出才释放，最低的已提交页就是栈的最高水位
+        if(stack && va < p->stack_low)
+            p->stack_low = va;
+        return 0;
+    }
+    if(va == USER_STACK_GUARD)
+        pr_err("pid %lu: 用户栈溢出（超过 %lu KB）\n", p->pid, USER_STACK_SIZE / 1024);
+    return -1;
+}
+
+// 查找用户地址 va 所在页的内核地址，要求 EL0 可访问，write 时还要求可写；
+// 尚未分配的栈页和写时复制页先按缺页处理
+uint8 *uvm_lookup(struct proc *p, uint64 va, int write) {
+    if(va >= (1UL << 48))
+        return 0;
+    uint64 *pte = walk(p->pagetable, va, 0);
+    if(!pte || !(*pte & PTE_VALID) || (write && (*pte & (PTE_COW | PTE_SHARED)) && (*pte & PTE_RDONLY))) {
+        if(uvm_fault(p, va, write) < 0)
+            return 0;
+        pte = walk(p->pagetable, va, 0);
+    }
+    if(!(*pte & PTE_USER))
+        return 0;
+    if(write && (*pte & PTE_RDONLY))
+        return 0;
+    return (uint8 *)P2V(PTE_ADDR(*pte));
+}
+
+// 把 p 在 va 处独占的可写页摘下，返回其内核地址，调用者接过这一页的引用。
+// 尚未分配和写时复制的页先按写入处理；共享页不能摘下
+uint8 *uvm_unmap_page(struct proc *p, uint64 va) {
+    uint8 *page = uvm_lookup(p, va, 1);
+    if(!page)
+        return 0;
+    uint64 *pte = walk(p->pagetable, va, 0);
+    if((*pte & PTE_SHARED) || page_refcount(page) != 1)
+        return 0;
+    *pte = 0;
+    tlb_flush_page(p, va);
+    return page;
+}
+
+// 把 page 可写地映射到 p 的 va 处，原来映射在那里的页放弃引用；page 的引用转给页表
+int uvm_replace_page(struct proc *p, uint64 va, uint8 *page) {
+    uint64 *pte = walk(p->pagetable, va, 1);
+    if(!pte)
+        return -1;
+    if(*pte & PTE_VALID) {
+        uint8 *old = (uint8 *)P2V(PTE_ADDR(*pte));
+        *pte = 0;
+        tlb_flush_page(p, va);
+        page_put(old);
+    }
+    return uvm_map(p->pagetable, va, PAGE_SIZE, V2P(page), UVM_RW);
+}
+
+// 撤销 p 从 va 起 npages 页的映射并放弃这些页的引用，没有映射的页跳过。
+// 与 tlb_flush_page 一样，p 须是当前进程或还没有运行过
+void uvm_unmap(struct proc *p, uint64 va, uint64 npages) {
+    for(uint64 i = 0; i < npages; i++, va += PAGE_SIZE) {
+        uint64 *pte = walk(p->pagetable, va, 0);
+        if(!pte || !(*pte & PTE_VALID))
+            continue;
+        uint8 *page = (uint8 *)P2V(PTE_ADDR(*pte));
+        *pte = 0;
+        tlb_flush_page(p, va);
+        page_put(page);
+    }
+}
+
+// 把文件 name 从第 pgoff 页开始的 len 字节映射到 p 的文件映射区，返回起始地址，失败返回 0。
+// 只建立映射区，页在第一次访问时从页缓存映射进来；超出文件末尾的页访问时出错
+uint64 uvm_mmap(struct proc *p, const char *name, uint32 pgoff, uint64 len, int writable) {
+    if(len == 0 || p->mmap_top + PGROUNDUP(len) > USER_STACK_GUARD)
+        return 0;
+    for(int i = 0; i < NVMA; i++) {
+        struct vma *v = &p->vma[i];
+        if(v->end)
+            continue;
+        v->start = p->mmap_top;
+        v->end = v->start + PGROUNDUP(len);
+        v->pgoff = pgoff;
+        v->writable = writable;
+        memcpy(v->name, name, 11);
+        p->mmap_top = v->end;
+        return v->start;
+    }
+    return 0;
+}
+
+// 把 [va, va + len) 内被写过的文件页写回磁盘，并把映射改回只读以便发现之后的写入
+int uvm_msync(struct proc *p, uint64 va, uint64 len) {
+    int r = 0;
+    for(uint64 a = PGROUNDDOWN(va); a < va + len; a += PAGE_SIZE) {
+        struct vma *v = vma_find(p, a);
+        uint64 *pte = walk(p->pagetable, a, 0);
+        if(!v || !pte || !(*pte & PTE_VALID) || (*pte & PTE_RDONLY))
+            continue;
+        *pte |= PTE_RDONLY;
+        tlb_flush_page(p, a);
+        if(pcache_writeback(v->name, v->pgoff + (a - v->start) / PAGE_SIZE) < 0)
+            r = -1;
+    }
+    return r;
+}
+
+// 从用户地址 srcva 拷贝 len 字节到内核，地址无效时返回 -1
+int copyin(struct proc *p, void *dst, uint64 srcva, uint64 len) {
+    uint8 *d = dst;
+    while(len > 0) {
+        uint64 off = srcva & (PAGE_SIZE - 1);
+        uint64 n = PAGE_SIZE - off;
+        if(n > len)
+            n = len;
+        uint8 *page = uvm_lookup(p, srcva, 0);
+        if(!page)
+            return -1;
+        memcpy(d, page + off, n);
+        d += n;
+        srcva += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 从内核拷贝 len 字节到用户地址 dstva，地址无效或只读时返回 -1
+int copyout(struct proc *p, uint64 dstva, const void *src, uint64 len) {
+    const uint8 *s = src;
+    while(len > 0) {
+        uint64 off = dstva & (PAGE_SIZE - 1);
+        uint64 n = PAGE_SIZE - off;
+        if(n > len)
+            n = len;
+        uint8 *page = uvm_lookup(p, dstva, 1);
+        if(!page)
+            return -1;
+        memcpy(page + off, s, n);
+        s += n;
+        dstva += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 写入代码后使指令缓存与数据缓存一致
+void sync_icache(void *addr, uint64 len) {
+    uint64 ctr;
+    asm volatile("mrs %0, ctr_el0" : "=r" (ctr));
+    uint64 line = 4UL << ((ctr >> 16) & 0xf);
+    uint64 start = (uint64)addr & ~(line - 1);
+    for(uint64 a = start; a < (uint64)addr + len; a += line)
+        asm volatile("dc cvau, %0" : : "r" (a) : "memory");
+    asm volatile("dsb ish; ic iallu; dsb ish; isb" ::: "memory");
+}
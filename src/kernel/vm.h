@@ -0,0 +1,83 @@
+#ifndef _VM_H
+#define _VM_H
+
+#include "types.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_SHIFT 12
+#define PGROUNDUP(a) (((uint64)(a) + PAGE_SIZE - 1) & ~(uint64)(PAGE_SIZE - 1))
+#define PGROUNDDOWN(a) ((uint64)(a) & ~(uint64)(PAGE_SIZE - 1))
+
+// 页表项（4KB 粒度，四级页表 L0-L3）
+#define PTE_VALID   (1UL << 0)
+#define PTE_TABLE   (1UL << 1)   // L0-L2：指向下一级页表
+#define PTE_PAGE    (1UL << 1)   // L3：页描述符
+#define PTE_ATTR(i) ((uint64)(i) << 2)
+#define PTE_USER    (1UL << 6)   // AP[1]：EL0 可访问
+#define PTE_RDONLY  (1UL << 7)   // AP[2]：只读
+#define PTE_SH      (3UL << 8)   // 内部共享
+#define PTE_AF      (1UL << 10)  // 访问标志
+#define PTE_NG      (1UL << 11)  // 非全局，TLB 项按 ASID 区分
+#define PTE_CONT    (1UL << 52)  // 连续位：16 个对齐的相邻项属性相同
+#define PTE_PXN     (1UL << 53)  // EL1 不可执行
+#define PTE_UXN     (1UL << 54)  // EL0 不可执行
+#define PTE_COW     (1UL << 55)  // 软件位：写时复制共享的只读页
+#define PTE_SHARED  (1UL << 56)  // 软件位：映射的是页缓存页，写入不复制
+
+#define PTE_ADDR(pte) ((pte) & 0x0000fffffffff000UL)
+
+// MAIR_EL1 属性下标，见 boot.S
+#define MT_DEVICE 0
+#define MT_NORMAL 1
+
+// 用户页权限
+#define UVM_RW  (PTE_USER | PTE_UXN)
+#define UVM_RO  (PTE_USER | PTE_RDONLY | PTE_UXN)
+#define UVM_RX  (PTE_USER | PTE_RDONLY)
+#define UVM_RWX (PTE_USER)
+
+// 用户地址空间布局
+#define USER_BASE      0x400000UL     // 程序映像装入地址，也是入口
+#define USER_STACK_TOP 0x80000000UL   // 用户栈顶
+// 用户栈保留 1MB 虚拟地址，只有用到的页才分配；最低一页是保护页，永不映射
+#define USER_STACK_SIZE (1024 * 1024UL)
+#define USER_STACK_GUARD (USER_STACK_TOP - USER_STACK_SIZE)
+#define MMAP_BASE      0x40000000UL   // 文件映射从这里向上分配
+
+// 文件映射区：[start, end) 映射文件 name 从第 pgoff 页开始的内容
+#define NVMA 4
+struct vma {
+    uint64 start;
+    uint64 end;       // 0 表示空闲
+    uint32 pgoff;
+    int writable;
+    char name[11];
+};
+
+typedef uint64 *pagetable_t;
+
+struct proc;
+
+// 函数声明
+void vm_init(void);
+void kernel_remap(int large);
+pagetable_t uvm_create(void);
+void uvm_free(pagetable_t pgd);
+int uvm_map(pagetable_t pgd, uint64 va, uint64 size, uint64 pa, uint64 perm);
+uint64 *walk(pagetable_t pgd, uint64 va, int alloc);
+int uvm_copy(struct proc *src, struct proc *dst);
+int uvm_fault(struct proc *p, uint64 va, int write);
+uint64 uvm_mmap(struct proc *p, const char *name, uint32 pgoff, uint64 len, int writable);
+int uvm_msync(struct proc *p, uint64 va, uint64 len);
+uint8 *uvm_unmap_page(struct proc *p, uint64 va);
+int uvm_replace_page(struct proc *p, uint64 va, uint8 *page);
+void uvm_unmap(struct proc *p, uint64 va, uint64 npages);
+uint8 *uvm_lookup(struct proc *p, uint64 va, int write);
+int copyin(struct proc *p, void *dst, uint64 srcva, uint64 len);
+int copyout(struct proc *p, uint64 dstva, const void *src, uint64 len);
+void sync_icache(void *addr, uint64 len);
+void vm_switch(pagetable_t pgd, uint64 *asid);
+void vm_set_asid(int enabled);
+uint64 vm_asid_rollovers(void);
+
+#endif
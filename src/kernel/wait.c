@@ -0,0 +1,167 @@
+#include "wait.h"
+#include "aarch64.h"
+#include "proc.h"
+#include "timer.h"
+#include "trap.h"
+
+void wait_queue_init(struct wait_queue *wq) {
+    wq->head = 0;
+    wq->tail = 0;
+}
+
+// 把当前进程挂到等待队列尾部并让出 CPU
+// 调用者必须已 push_off，使检查条件与睡眠成为原子操作
+void wait_sleep(struct wait_queue *wq) {
+    struct proc *p = myproc();
+    if(p == 0)
+        panic("wait_sleep: no process");
+
+    p->wait = wq;
+    p->wait_next = 0;
+    if(wq->tail)
+        wq->tail->wait_next = p;
+    else
+        wq->head = p;
+    wq->tail = p;
+
+    p->state = BLOCKED;
+    sched();
+}
+
+// 带超时的睡眠：定时事件到期时进程还在等待队列上，就把它摘下并唤醒
+struct wait_timeout {
+    struct timer t;
+    struct proc *p;
+    int expired;
+};
+
+static void wait_timeout_fn(struct timer *t) {
+    struct wait_timeout *w = (struct wait_timeout *)t;
+    struct proc *p = w->p;
+    // 已被唤醒、只是还没运行的进程不算超时
+    struct wait_queue *wq = p->wait;
+    if(!wq)
+        return;
+    w->expired = 1;
+    struct proc **pp = &wq->head, *prev = 0;
+    while(*pp != p) {
+        prev = *pp;
+        pp = &(*pp)->wait_next;
+    }
+    *pp = p->wait_next;
+    if(wq->tail == p)
+        wq->tail = prev;
+    p->wait_next = 0;
+    p->wait = 0;
+    proc_ready(p);
+}
+
+// 同 wait_sleep，但最迟在 deadline（CNTVCT_EL0 计数）醒来。被唤醒返回 0，超时返回 -1。
+// 调用者必须已 push_off
+int wait_sleep_until(struct wait_queue *wq, uint64 deadline) {
+    if(r_cntvct() >= deadline)
+        return -1;
+    struct wait_timeout w;
+    w.p = myproc();
+    w.expired = 0;
+    timer_add(&w.t, deadline, wait_timeout_fn);
+    wait_sleep(wq);
+    timer_cancel(&w.t);
+    return w.expired ? -1 : 0;
+}
+
+// 取下队首的进程但不唤醒，它保持阻塞，由调用者决定何时运行。调用者必须已 push_off
+struct proc* wait_dequeue(struct wait_queue *wq) {
+    struct proc *p = wq->head;
+    if(p) {
+        wq->head = p->wait_next;
+        if(wq->head == 0)
+            wq->tail = 0;
+        p->wait_next = 0;
+        p->wait = 0;
+    }
+    return p;
+}
+
+// 唤醒队首的一个进程，返回被唤醒的进程
+struct proc* wake_one(struct wait_queue *wq) {
+    push_off();
+    struct proc *p = wait_dequeue(wq);
+    if(p)
+        proc_ready(p);
+    pop_off();
+    return p;
+}
+
+// 唤醒队列上的全部进程，返回唤醒个数
+int wake_all(struct wait_queue *wq) {
+    int n = 0;
+    while(wake_one(wq))
+        n++;
+    return n;
+}
+
+void mutex_init(struct mutex *m) {
+    m->locked = 0;
+    m->owner = 0;
+    wait_queue_init(&m->wq);
+}
+
+void mutex_lock(struct mutex *m) {
+    struct proc *p = myproc();
+    push_off();
+    if(m->locked) {
+        if(p == 0)
+            panic("mutex_lock: contended without process");
+        if(m->owner == p)
+            panic("mutex_lock: recursive");
+        // 锁由解锁者直接移交，醒来时已是持有者
+        while(m->owner != p)
+            wait_sleep(&m->wq);
+    } else {
+        m->locked = 1;
+        m->owner = p;
+    }
+    pop_off();
+}
+
+void mutex_unlock(struct mutex *m) {
+    push_off();
+    if(!m->locked)
+        panic("mutex_unlock");
+    struct proc *next = m->wq.head;
+    if(next) {
+        // 移交给队首等待者，锁保持占用
+        m->owner = next;
+        wake_one(&m->wq);
+    } else {
+        m->locked = 0;
+        m->owner = 0;
+    }
+    pop_off();
+}
+
+int mutex_holding(struct mutex *m) {
+    return m->locked && m->owner == myproc();
+}
+
+void cond_init(struct cond *cv) {
+    wait_queue_init(&cv->wq);
+}
+
+// 原子地释放互斥锁并睡眠，醒来后重新获得锁
+void cond_wait(struct cond *cv, struct mutex *m) {
+    push_off();
+    mutex_unlock(m);
+    wait_sleep(&cv->wq);
+    pop_off();
+    mutex_lock(m);
+}
+
+void cond_signal(struct cond *cv) {
+    wake_one(&cv->wq);
+}
+
+void cond_broadcast(struct cond *cv) {
+    wake_all(&cv->wq);
+}
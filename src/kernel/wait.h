@@ -0,0 +1,76 @@
+#ifndef _WAIT_H
+#define _WAIT_H
+
+#include "types.h"
+#include "aarch64.h"
+#include "timer.h"
+
+struct proc;
+
+// 等待队列：按 FIFO 顺序挂着阻塞的进程
+struct wait_queue {
+    struct proc *head;
+    struct proc *tail;
+};
+
+#define WAIT_QUEUE_INIT { 0, 0 }
+
+// 睡眠互斥锁：解锁时直接把锁交给队首等待者，不会惊群
+struct mutex {
+    int locked;
+    struct proc *owner;      // 持有者，0 表示非进程上下文
+    struct wait_queue wq;
+};
+
+#define MUTEX_INIT { 0, 0, WAIT_QUEUE_INIT }
+
+// 条件变量
+struct cond {
+    struct wait_queue wq;
+};
+
+#define COND_INIT { WAIT_QUEUE_INIT }
+
+// 函数声明
+void wait_queue_init(struct wait_queue *wq);
+void wait_sleep(struct wait_queue *wq);
+struct proc* wait_dequeue(struct wait_queue *wq);
+int wait_sleep_until(struct wait_queue *wq, uint64 deadline);
+struct proc* wake_one(struct wait_queue *wq);
+int wake_all(struct wait_queue *wq);
+
+void mutex_init(struct mutex *m);
+void mutex_lock(struct mutex *m);
+void mutex_unlock(struct mutex *m);
+int mutex_holding(struct mutex *m);
+
+void cond_init(struct cond *cv);
+void cond_wait(struct cond *cv, struct mutex *m);
+void cond_signal(struct cond *cv);
+void cond_broadcast(struct cond *cv);
+
+// 睡眠直到条件成立；条件在关中断下检查，不会丢失唤醒
+#define wait_event(wq, cond)          \
+    do {                              \
+        push_off();                   \
+        while(!(cond))                \
+            wait_sleep(wq);           \
+        pop_off();                    \
+    } while(0)
+
+// 同 wait_event，但最多等 ns 纳秒：条件成立时 ret 为 0，超时为 -1
+#define wait_event_timeout(wq, cond, ns, ret)                           \
+    do {                                                                \
+        uint64 _deadline = r_cntvct() + ns_to_ticks(ns);                \
+        (ret) = 0;                                                      \
+        push_off();                                                     \
+        while(!(cond)) {                                                \
+            if(wait_sleep_until(wq, _deadline) < 0 && !(cond)) {        \
+                (ret) = -1;                                             \
+                break;                                                  \
+            }                                                           \
+        }                                                               \
+        pop_off();                                                      \
+    } while(0)
+
+#endif
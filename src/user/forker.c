@@ -0,0 +1,37 @@
+#include "user.h"
+
+// fork + exit 基准：arg 低 32 位是 fork 次数，高 32 位是 fork 前先用掉的栈（KB）。
+// 写时复制下 fork 的开销只和页表大小有关，不随已用内存线性增长
+static void fork_loop(uint64 n) {
+    for(uint64 i = 0; i < n; i++) {
+        int pid = fork();
+        if(pid == 0)
+            exit();
+        if(pid < 0) {
+            puts("forker: fork failed\n");
+            return;
+        }
+        wait(pid);
+    }
+}
+
+static int use_stack(uint64 kib, uint64 n) {
+    volatile char buf[1024];
+    buf[0] = kib;
+    buf[sizeof(buf) - 1] = kib;
+    if(kib > 1)
+        buf[0] += use_stack(kib - 1, n);
+    else
+        fork_loop(n);
+    return buf[0] + buf[sizeof(buf) - 1];
+}
+
+int main(uint64 arg) {
+    uint64 n = arg & 0xffffffff;
+    uint64 kib = arg >> 32;
+    if(kib)
+        use_stack(kib, n);
+    else
+        fork_loop(n);
+    return 0;
+}
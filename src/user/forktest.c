@@ -0,0 +1,24 @@
+#include "user.h"
+
+// 写时复制检查：子进程改写的数据和栈不影响父进程
+static int shared = 1;
+
+int main(uint64 arg) {
+    int local = 1;
+    int pid = fork();
+    if(pid < 0) {
+        puts("forktest: fork failed\n");
+        return 1;
+    }
+    if(pid == 0) {
+        shared = 2;
+        local = 2;
+        exit();
+    }
+    wait(pid);
+    if(shared == 1 && local == 1)
+        puts("forktest: ok\n");
+    else
+        puts("forktest: child write leaked into parent\n");
+    return 0;
+}
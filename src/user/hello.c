@@ -0,0 +1,9 @@
+#include "user.h"
+
+// 第一个用户程序：在 EL0 打印自己的 pid 后退出
+int main(uint64 arg) {
+    puts("hello from EL0, pid ");
+    putnum(getpid());
+    puts("\n");
+    return 0;
+}
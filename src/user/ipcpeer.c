@@ -0,0 +1,54 @@
+#include "user.h"
+
+// IPC 基准的一端：arg 低 8 位是通道 id，IPCPEER_RECV 位置位时接收、否则发送，
+// IPCPEER_PAGES 位置位时每条消息是 64KB 的整页转移、否则是 64 字节内联消息，高 32 位是消息数。
+// 每条消息带序号，接收方逐条检查
+#define IPCPEER_RECV  (1UL << 8)
+#define IPCPEER_PAGES (1UL << 9)
+#define MSG_SMALL 64
+#define MSG_LARGE (64 * 1024)
+
+int main(uint64 arg) {
+    struct ipc_end e;
+    int recv = (arg & IPCPEER_RECV) != 0;
+    uint64 n = arg >> 32;
+    uint64 errors = 0;
+    if(ipc_open(&e, arg & 0xff, recv) < 0) {
+        puts("ipcpeer: ipc_open failed\n");
+        return 1;
+    }
+    uint64 *buf = (uint64 *)IPC_BUF_BASE;
+    uint64 msg[MSG_SMALL / 8];
+
+    for(uint64 i = 0; i < n; i++) {
+        if(arg & IPCPEER_PAGES) {
+            if(recv) {
+                if(ipc_recv_pages(&e, buf) != MSG_LARGE)
+                    errors++;
+                for(uint64 off = 0; off < MSG_LARGE / 8; off += 4096 / 8)
+                    errors += buf[off] != i;
+            } else {
+                // 每页开头写序号；转走后这段缓冲区再访问得到新的清零页
+                for(uint64 off = 0; off < MSG_LARGE / 8; off += 4096 / 8)
+                    buf[off] = i;
+                if(ipc_send_pages(&e, buf, MSG_LARGE) < 0)
+                    errors++;
+            }
+        } else {
+            if(recv) {
+                if(ipc_recv(&e, msg, sizeof(msg)) != MSG_SMALL || msg[0] != i)
+                    errors++;
+            } else {
+                msg[0] = i;
+                if(ipc_send(&e, msg, sizeof(msg)) < 0)
+                    errors++;
+            }
+        }
+    }
+    if(errors) {
+        puts("ipcpeer: errors ");
+        putnum(errors);
+        puts("\n");
+    }
+    return errors != 0;
+}
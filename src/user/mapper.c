@@ -0,0 +1,32 @@
+#include "user.h"
+
+// 文件映射：arg 低 32 位是遍历次数，MAPPER_WRITE 位置位时先把每页第一个字节加一再 msync。
+// 每次遍历把映射的内容求和，第二次起全部命中页缓存，不再读磁盘也不拷贝
+#define MAPPER_WRITE (1UL << 32)
+#define MAPPER_LEN   (16 * 1024)
+
+int main(uint64 arg) {
+    uint64 passes = arg & 0xffffffff;
+    int writable = (arg & MAPPER_WRITE) != 0;
+    volatile uint8 *p = mmap("MAPTEST BIN", 0, MAPPER_LEN, PROT_READ | (writable ? PROT_WRITE : 0));
+    if(!p) {
+        puts("mapper: mmap failed\n");
+        return 1;
+    }
+    if(writable) {
+        for(uint64 off = 0; off < MAPPER_LEN; off += 4096)
+            p[off]++;
+        if(msync((void *)p, MAPPER_LEN) < 0)
+            puts("mapper: msync failed\n");
+    }
+    uint64 sum = 0;
+    for(uint64 i = 0; i < passes; i++)
+        for(uint64 off = 0; off < MAPPER_LEN; off += 8)
+            sum += *(volatile uint64 *)(p + off);
+    if(writable) {
+        puts("mapper: sum ");
+        putnum(sum);
+        puts("\n");
+    }
+    return 0;
+}
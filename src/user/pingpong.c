@@ -0,0 +1,38 @@
+#include "user.h"
+
+// 同步调用往返：arg 低 8 位是端点 id，PINGPONG_SERVER 位置位时作为服务进程，
+// 否则作为客户，高 32 位是调用次数。服务进程把第一个字加一后回复，
+// 收到 PINGPONG_QUIT 时不再回复直接退出，客户的这次调用返回 -1
+#define PINGPONG_SERVER (1UL << 8)
+#define PINGPONG_QUIT   (~0UL)
+
+int main(uint64 arg) {
+    int ep = arg & 0xff;
+    struct ipc_msg m;
+
+    if(arg & PINGPONG_SERVER) {
+        m.w[0] = 0;
+        // 第一次 reply_wait 没有要回复的调用者，只等待
+        while(reply_wait(ep, &m) >= 0) {
+            if(m.w[0] == PINGPONG_QUIT)
+                break;
+            m.w[0]++;
+        }
+        return 0;
+    }
+
+    uint64 n = arg >> 32, errors = 0;
+    for(uint64 i = 0; i < n; i++) {
+        m.w[0] = i;
+        if(call(ep, &m) < 0 || m.w[0] != i + 1)
+            errors++;
+    }
+    m.w[0] = PINGPONG_QUIT;
+    call(ep, &m);
+    if(errors) {
+        puts("pingpong: errors ");
+        putnum(errors);
+        puts("\n");
+    }
+    return errors != 0;
+}
@@ -0,0 +1,9 @@
+#include "user.h"
+
+// CPU 密集的用户进程：空转 arg 次后退出，从不主动让出 CPU
+int main(uint64 arg) {
+    volatile uint64 x = 0;
+    for(uint64 i = 0; i < arg; i++)
+        x += i;
+    return 0;
+}
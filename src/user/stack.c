@@ -0,0 +1,28 @@
+#include "user.h"
+
+// arg 低 32 位是 kib：用掉大约 kib KB 的栈后让出一次 CPU 再退出；
+// kib 超过栈保留区时会撞上保护页，进程被内核结束。
+// STACK_HOLD 位置位时，退出前在 IPC 通道（id 在 40 位起）上睡眠，直到通道被关闭，
+// 让内核在进程仍占着栈时测量内存
+#define STACK_HOLD (1UL << 32)
+static int use_stack(uint64 kib) {
+    volatile char buf[1024];
+    buf[0] = kib;
+    buf[sizeof(buf) - 1] = kib;
+    if(kib > 1)
+        buf[0] += use_stack(kib - 1);  // 递归返回后还要用到 buf，不会变成尾调用
+    return buf[0] + buf[sizeof(buf) - 1];
+}
+
+int main(uint64 arg) {
+    uint64 kib = arg & 0xffffffff;
+    if(kib)
+        use_stack(kib);
+    yield();
+    if(arg & STACK_HOLD) {
+        // 没有人发消息，只在通道关闭时返回 -1
+        while(ipc_wait((arg >> 40) & 0xff, 0, IPC_WAIT_DATA) == 0)
+            ;
+    }
+    return 0;
+}
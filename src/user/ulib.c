@@ -0,0 +1,153 @@
+#include "user.h"
+
+int strlen(const char *s) {
+    int n = 0;
+    while(s[n])
+        n++;
+    return n;
+}
+
+// 源和目标都按 8 字节对齐时按字拷贝
+void *memcpy(void *dst, const void *src, uint64 n) {
+    uint8 *d = dst;
+    const uint8 *s = src;
+    if((((uint64)d | (uint64)s) & 7) == 0) {
+        for(; n >= 8; d += 8, s += 8, n -= 8)
+            *(uint64 *)d = *(const uint64 *)s;
+    }
+    while(n-- > 0)
+        *d++ = *s++;
+    return dst;
+}
+
+// 输出字符串，不追加换行
+void puts(const char *s) {
+    write(s, strlen(s));
+}
+
+// 输出十进制整数
+void putnum(uint64 n) {
+    char buf[21];
+    int i = sizeof(buf);
+    do {
+        buf[--i] = '0' + n % 10;
+        n /= 10;
+    } while(n);
+    write(buf + i, sizeof(buf) - i);
+}
+
+void sleep_ms(uint64 ms) {
+    sleep_ns(ms * 1000000);
+}
+
+// IPC 消息环（见 ipc.h）：发送方写好槽再推进 tail，接收方读完槽再推进 head，都不进内核。
+// 只有环满或环空时才置 want_* 并睡眠，对方推进序号后看到 want_* 才敲门铃
+static inline void ipc_mb(void) {
+    asm volatile("dmb ish" ::: "memory");
+}
+
+int ipc_open(struct ipc_end *e, int id, int side) {
+    e->id = id;
+    e->tx = side;
+    e->rx = !side;
+    e->sh = ipc_map(id);
+    return e->sh ? 0 : -1;
+}
+
+// 等到发送环有空槽，返回该槽；通道关闭时返回 0
+static struct ipc_slot *ipc_tx_slot(struct ipc_end *e) {
+    struct ipc_ctl *c = &e->sh->ctl[e->tx];
+    while(c->tail - c->head >= IPC_SLOTS) {
+        c->want_space = 1;
+        ipc_mb();
+        if(c->tail - c->head < IPC_SLOTS)
+            break;
+        if(ipc_wait(e->id, e->tx, IPC_WAIT_SPACE) < 0)
+            return 0;
+    }
+    c->want_space = 0;
+    return &e->sh->slot[e->tx][c->tail % IPC_SLOTS];
+}
+
+static void ipc_tx_publish(struct ipc_end *e) {
+    struct ipc_ctl *c = &e->sh->ctl[e->tx];
+    // 槽的内容先于 tail 可见；tail 写入后再检查对方是否在睡眠
+    ipc_mb();
+    c->tail = c->tail + 1;
+    ipc_mb();
+    if(c->want_data)
+        ipc_notify(e->id, e->tx);
+}
+
+// 等到接收环有消息，返回该槽；通道关闭时返回 0
+static struct ipc_slot *ipc_rx_slot(struct ipc_end *e) {
+    struct ipc_ctl *c = &e->sh->ctl[e->rx];
+    while(c->tail == c->head) {
+        c->want_data = 1;
+        ipc_mb();
+        if(c->tail != c->head)
+            break;
+        if(ipc_wait(e->id, e->rx, IPC_WAIT_DATA) < 0)
+            return 0;
+    }
+    c->want_data = 0;
+    ipc_mb();
+    return &e->sh->slot[e->rx][c->head % IPC_SLOTS];
+}
+
+static void ipc_rx_release(struct ipc_end *e) {
+    struct ipc_ctl *c = &e->sh->ctl[e->rx];
+    ipc_mb();
+    c->head = c->head + 1;
+    ipc_mb();
+    if(c->want_space)
+        ipc_notify(e->id, e->rx);
+}
+
+// 发送不超过 IPC_MSG_MAX 字节的消息，内容拷贝进槽
+int ipc_send(struct ipc_end *e, const void *buf, uint32 len) {
+    if(len > IPC_MSG_MAX)
+        return -1;
+    struct ipc_slot *s = ipc_tx_slot(e);
+    if(!s)
+        return -1;
+    s->len = len;
+    s->flags = 0;
+    memcpy(s->data, buf, len);
+    ipc_tx_publish(e);
+    return len;
+}
+
+// 接收一条内联消息，返回长度；下一条消息是整页转移或超过 cap 时返回 -1 且不取走
+int ipc_recv(struct ipc_end *e, void *buf, uint32 cap) {
+    struct ipc_slot *s = ipc_rx_slot(e);
+    if(!s || (s->flags & IPC_MSG_PAGES) || s->len > cap)
+        return -1;
+    uint32 len = s->len;
+    memcpy(buf, s->data, len);
+    ipc_rx_release(e);
+    return len;
+}
+
+// 把缓冲区（IPC_BUF_BASE 起，按页对齐）中的 len 字节整页转给对方，不拷贝。
+// 返回后这段缓冲区变成新的清零页
+int ipc_send_pages(struct ipc_end *e, void *buf, uint64 len) {
+    struct ipc_slot *s = ipc_tx_slot(e);
+    if(!s || ipc_give(e->id, e->tx, buf, len) < 0)
+        return -1;
+    s->len = len;
+    s->flags = IPC_MSG_PAGES;
+    ipc_tx_publish(e);
+    return len;
+}
+
+// 接收一次整页转移，映射到 buf（按页对齐的缓冲区地址），返回字节数
+int ipc_recv_pages(struct ipc_end *e, void *buf) {
+    struct ipc_slot *s = ipc_rx_slot(e);
+    if(!s || !(s->flags & IPC_MSG_PAGES))
+        return -1;
+    // 先取走页再释放槽，内核中挂着的转移不会多于环中的消息
+    int len = ipc_take(e->id, e->rx, buf);
+    ipc_rx_release(e);
+    return len;
+}
@@ -0,0 +1,51 @@
+#ifndef _USER_H
+#define _USER_H
+
+#include "types.h"
+#include "syscall.h"
+#include "ipc.h"
+#include "ioring.h"
+
+// 系统调用，见 usys.S
+void exit(void) __attribute__((noreturn));
+int write(const char *buf, int len);
+void yield(void);
+int getpid(void);
+int fork(void);
+void wait(int pid);
+void *mmap(const char *name, uint64 offset, uint64 len, int prot);
+int msync(void *addr, uint64 len);
+int ipc_create(void);
+int ipc_close(int id);
+struct ipc_shared *ipc_map(int id);
+int ipc_wait(int id, int ring, int what);
+int ipc_notify(int id, int ring);
+int ipc_give(int id, int ring, void *buf, uint64 len);
+int ipc_take(int id, int ring, void *buf);
+int ep_create(void);
+int call(int ep, struct ipc_msg *m);
+int reply_wait(int ep, struct ipc_msg *m);
+struct io_rings *io_setup(void);
+int io_enter(uint32 to_submit, uint32 min_complete);
+void sleep_ns(uint64 ns);
+
+// 通道的一端：side 0 在环 0 上发送、环 1 上接收，side 1 相反
+struct ipc_end {
+    int id;
+    int tx, rx;
+    struct ipc_shared *sh;
+};
+
+// ulib.c
+int strlen(const char *s);
+void *memcpy(void *dst, const void *src, uint64 n);
+void puts(const char *s);
+void putnum(uint64 n);
+void sleep_ms(uint64 ms);
+int ipc_open(struct ipc_end *e, int id, int side);
+int ipc_send(struct ipc_end *e, const void *buf, uint32 len);
+int ipc_recv(struct ipc_end *e, void *buf, uint32 cap);
+int ipc_send_pages(struct ipc_end *e, void *buf, uint64 len);
+int ipc_recv_pages(struct ipc_end *e, void *buf);
+
+#endif
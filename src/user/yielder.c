@@ -0,0 +1,16 @@
+#include "user.h"
+
+// 切换开销测试用：每轮写 NPAGES 个页再让出 CPU，
+// 让 TLB 里始终有本进程的映射，切换时是否刷新 TLB 的差别才能体现出来
+#define NPAGES 8
+
+static char buf[NPAGES * 4096];
+
+int main(uint64 iters) {
+    for(uint64 i = 0; i < iters; i++) {
+        for(int j = 0; j < NPAGES; j++)
+            buf[j * 4096]++;
+        yield();
+    }
+    return 0;
+}
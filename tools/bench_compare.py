@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""Compare two benchmark result files produced by `make bench`.
+
+Usage: bench_compare.py old.jsonl new.jsonl [threshold-percent]
+Exits with status 1 if any benchmark's ns_per_op regressed by more than the
+threshold (default 10%).
+"""
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            rec = json.loads(line)
+            if "bench" in rec:
+                results[rec["bench"]] = rec
+    return results
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    old, new = load(sys.argv[1]), load(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 10.0
+
+    regressed = False
+    print("%-28s %14s %14s %9s" % ("bench", "old ns/op", "new ns/op", "change"))
+    for name in sorted(set(old) | set(new)):
+        if name not in old or name not in new:
+            print("%-28s %14s %14s %9s" % (name, old.get(name, {}).get("ns_per_op", "-"),
+                                            new.get(name, {}).get("ns_per_op", "-"), "n/a"))
+            continue
+        a, b = old[name]["ns_per_op"], new[name]["ns_per_op"]
+        change = (b - a) * 100.0 / a if a else 0.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressed = True
+        print("%-28s %14d %14d %+8.1f%%%s" % (name, a, b, change, flag))
+    sys.exit(1 if regressed else 0)
+
+
+if __name__ == "__main__":
+    main()
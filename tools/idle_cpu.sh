@@ -0,0 +1,39 @@
+#!/bin/sh
+# 测量空闲客户机占用的主机 CPU：启动 kernel.bin，等测试跑完进入空闲，
+# 再从 /proc/<pid>/stat 统计 QEMU 进程在一段时间内的用户态加内核态时间
+# 用法：idle_cpu.sh <构建目录> [等待秒数] [测量秒数]
+set -e
+
+BUILD=${1:-.}
+SETTLE=${2:-10}
+DURATION=${3:-10}
+cd "$BUILD"
+
+rm -f idle-disk.img
+dd if=/dev/zero of=idle-disk.img bs=1M count=10 2>/dev/null
+mkfs.fat -F 16 idle-disk.img >/dev/null
+
+qemu-system-aarch64 \
+    -cpu cortex-a72 \
+    -machine virt,gic-version=3 \
+    -kernel kernel.bin \
+    -m 128M \
+    -display none \
+    -serial file:idle.log \
+    -monitor none \
+    -drive file=idle-disk.img,if=none,format=raw,id=x0 \
+    -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0 &
+PID=$!
+trap 'kill $PID 2>/dev/null' EXIT
+
+# /proc/<pid>/stat 第 14、15 个字段是 utime、stime（时钟节拍）
+cpu_ticks() {
+    awk '{ print $14 + $15 }' /proc/$PID/stat
+}
+
+sleep "$SETTLE"
+T0=$(cpu_ticks)
+sleep "$DURATION"
+T1=$(cpu_ticks)
+HZ=$(getconf CLK_TCK)
+echo "$T0 $T1 $HZ $DURATION" | awk '{ printf "{\"idle_host_cpu_pct\":%.1f,\"seconds\":%d}\n", ($2 - $1) * 100 / $3 / $4, $4 }'
@@ -0,0 +1,38 @@
+#!/bin/sh
+# 在 QEMU 中运行 bench.bin，把 JSON 结果保存到 bench-results/
+# 用法：run_bench.sh <构建目录> [CPU 数]
+set -e
+
+BUILD=${1:-.}
+CPUS=${2:-1}
+cd "$BUILD"
+
+# 每次使用全新的磁盘镜像，保证结果可比
+rm -f bench-disk.img
+dd if=/dev/zero of=bench-disk.img bs=1M count=10 2>/dev/null
+mkfs.fat -F 16 bench-disk.img >/dev/null
+
+# 内核通过 PSCI SYSTEM_OFF 让 QEMU 退出；超时视为失败
+timeout 600 qemu-system-aarch64 \
+    -cpu cortex-a72 \
+    -machine virt,gic-version=3 \
+    -kernel bench.bin \
+    -m 128M \
+    -smp "$CPUS" \
+    -display none \
+    -serial file:bench.log \
+    -monitor none \
+    -drive file=bench-disk.img,if=none,format=raw,id=x0 \
+    -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
+
+mkdir -p bench-results
+OUT=bench-results/$(date +%Y%m%d-%H%M%S).jsonl
+tr -d '\r' < bench.log | grep '^{' > "$OUT"
+cp "$OUT" bench-results/latest.jsonl
+
+if ! grep -q '"bench_suite":"done"' "$OUT"; then
+    echo "benchmark did not complete, see $BUILD/bench.log" >&2
+    exit 1
+fi
+echo "results: $BUILD/$OUT"
+cat "$OUT"
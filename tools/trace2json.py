@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Convert a simple-os trace dump (Ctrl-T on the console) to Chrome trace JSON.
+
+Usage: trace2json.py serial.log > trace.json
+Open the result in chrome://tracing or https://ui.perfetto.dev.
+"""
+import json
+import sys
+
+SCHED_SWITCH = 1
+PAGE_ALLOC = 2
+PAGE_FREE = 3
+BLK_SUBMIT = 4
+BLK_COMPLETE = 5
+FAT_CLUSTER_READ = 6
+
+
+def parse(lines):
+    """Yield (freq, events) for every TRACE_BEGIN/TRACE_END block."""
+    freq, events = None, None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE_BEGIN"):
+            freq, events = int(line.split()[1]), []
+        elif line == "TRACE_END" and events is not None:
+            yield freq, events
+            freq, events = None, None
+        elif line.startswith("T ") and events is not None:
+            ts, cpu, pid, typ, a0, a1 = (int(x, 16) for x in line.split()[1:7])
+            events.append((ts, cpu, pid, typ, a0, a1))
+
+
+def convert(freq, events):
+    if not events:
+        return []
+    base = events[0][0]
+
+    def us(ts):
+        return (ts - base) * 1e6 / freq
+
+    out = []
+    running = {}  # cpu -> (pid, start ts)
+    for ts, cpu, pid, typ, a0, a1 in events:
+        if typ == SCHED_SWITCH:
+            prev = running.pop(cpu, None)
+            if prev is not None:
+                out.append({"name": "pid %d" % prev[0], "cat": "sched", "ph": "X",
+                            "ts": us(prev[1]), "dur": us(ts) - us(prev[1]),
+                            "pid": cpu, "tid": prev[0]})
+            if a1 != 0:
+                running[cpu] = (a1, ts)
+        elif typ in (PAGE_ALLOC, PAGE_FREE):
+            name = "alloc_pages" if typ == PAGE_ALLOC else "free_pages"
+            out.append({"name": name, "cat": "mm", "ph": "i", "s": "t",
+                        "ts": us(ts), "pid": cpu, "tid": pid,
+                        "args": {"addr": hex(a0), "pages": a1}})
+        elif typ == BLK_SUBMIT:
+            out.append({"name": "blk", "cat": "blk", "ph": "b",
+                        "id": a0, "ts": us(ts), "pid": cpu, "tid": pid,
+                        "args": {"sector": a0, "op": "write" if a1 else "read"}})
+        elif typ == BLK_COMPLETE:
+            out.append({"name": "blk", "cat": "blk", "ph": "e", "id": a0,
+                        "ts": us(ts), "pid": cpu, "tid": pid,
+                        "args": {"status": a1}})
+        elif typ == FAT_CLUSTER_READ:
+            out.append({"name": "fat_cluster_read", "cat": "fat", "ph": "i", "s": "t",
+                        "ts": us(ts), "pid": cpu, "tid": pid,
+                        "args": {"cluster": a0, "sector": a1}})
+    return out
+
+
+def main():
+    src = open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin
+    blocks = list(parse(src))
+    if not blocks:
+        sys.exit("no TRACE_BEGIN/TRACE_END block found")
+    # the last dump contains the most recent window
+    freq, events = blocks[-1]
+    json.dump({"traceEvents": convert(freq, events), "displayTimeUnit": "ns"},
+              sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()